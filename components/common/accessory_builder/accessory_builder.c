@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "accessory_builder.h"
+
+#define ACCESSORY_BUILDER_ALIGN(size) (((size) + 7) & ~7)
+
+
+struct _accessory_builder {
+    // First run only counts, all cursors below end up being sizes
+    bool counting;
+    bool invalid;
+
+    homekit_accessory_t *accessories;
+    homekit_service_t *services;
+    homekit_characteristic_t *characteristics;
+    uint32_t accessory_count;
+    uint32_t service_count;
+    uint32_t characteristic_count;
+
+    // NULL terminated pointer arrays, laid out back to back
+    homekit_accessory_t **accessory_list;
+    homekit_service_t **service_lists;
+    homekit_characteristic_t **characteristic_lists;
+    uint32_t service_list_used;
+    uint32_t characteristic_list_used;
+
+    uint8_t *data;
+    size_t data_used;
+
+    bool accessory_open;
+    bool service_open;
+
+    // Fill pass only: counts from the first run, arena is laid out for
+    // exactly these, so nothing is written past them
+    const accessory_builder_t *sizes;
+};
+
+
+// In fill pass, checks that one more item fits in space counted in the
+// first run. Build function producing more objects than in the first run
+// makes build invalid instead of overflowing arena.
+#define builder_full(builder, field) \
+    (!(builder)->counting && (builder)->field >= (builder)->sizes->field)
+
+
+static void *builder_alloc(accessory_builder_t *builder, size_t size) {
+    if (builder->invalid)
+        return NULL;
+
+    size = ACCESSORY_BUILDER_ALIGN(size);
+    if (!builder->counting && builder->data_used + size > builder->sizes->data_used) {
+        builder->invalid = true;
+        return NULL;
+    }
+
+    void *p = builder->counting ? NULL : builder->data + builder->data_used;
+    builder->data_used += size;
+    return p;
+}
+
+
+static void *builder_copy(accessory_builder_t *builder, const void *src, size_t size) {
+    void *p = builder_alloc(builder, size);
+    if (p)
+        memcpy(p, src, size);
+    return p;
+}
+
+
+static void builder_close_service(accessory_builder_t *builder) {
+    if (!builder->service_open)
+        return;
+
+    if (builder_full(builder, characteristic_list_used))
+        builder->invalid = true;
+    if (!builder->counting && !builder->invalid)
+        builder->characteristic_lists[builder->characteristic_list_used] = NULL;
+    builder->characteristic_list_used++;
+    builder->service_open = false;
+}
+
+
+static void builder_close_accessory(accessory_builder_t *builder) {
+    builder_close_service(builder);
+    if (!builder->accessory_open)
+        return;
+
+    if (builder_full(builder, service_list_used))
+        builder->invalid = true;
+    if (!builder->counting && !builder->invalid)
+        builder->service_lists[builder->service_list_used] = NULL;
+    builder->service_list_used++;
+    builder->accessory_open = false;
+}
+
+
+homekit_accessory_t *accessory_builder_accessory(accessory_builder_t *builder,
+                                                 const homekit_accessory_t *accessory) {
+    builder_close_accessory(builder);
+
+    if (builder_full(builder, accessory_count))
+        builder->invalid = true;
+    if (builder->invalid)
+        return NULL;
+
+    homekit_accessory_t *a = NULL;
+    if (!builder->counting) {
+        a = &builder->accessories[builder->accessory_count];
+        *a = *accessory;
+        a->services = &builder->service_lists[builder->service_list_used];
+        builder->accessory_list[builder->accessory_count] = a;
+    }
+    builder->accessory_count++;
+    builder->accessory_open = true;
+
+    return a;
+}
+
+
+homekit_service_t *accessory_builder_service(accessory_builder_t *builder,
+                                             const homekit_service_t *service) {
+    if (!builder->accessory_open) {
+        builder->invalid = true;
+        return NULL;
+    }
+
+    builder_close_service(builder);
+
+    if (builder_full(builder, service_count) || builder_full(builder, service_list_used))
+        builder->invalid = true;
+    if (builder->invalid)
+        return NULL;
+
+    homekit_service_t *s = NULL;
+    if (!builder->counting) {
+        s = &builder->services[builder->service_count];
+        *s = *service;
+        s->linked = NULL;
+        s->characteristics = &builder->characteristic_lists[builder->characteristic_list_used];
+        builder->service_lists[builder->service_list_used] = s;
+    }
+    builder->service_count++;
+    builder->service_list_used++;
+    builder->service_open = true;
+
+    return s;
+}
+
+
+homekit_characteristic_t *accessory_builder_characteristic(accessory_builder_t *builder,
+                                                           const homekit_characteristic_t *characteristic) {
+    if (!builder->service_open) {
+        builder->invalid = true;
+        return NULL;
+    }
+
+    if (builder_full(builder, characteristic_count) ||
+            builder_full(builder, characteristic_list_used))
+        builder->invalid = true;
+    if (builder->invalid)
+        return NULL;
+
+    homekit_characteristic_t *ch = NULL;
+    if (!builder->counting) {
+        ch = &builder->characteristics[builder->characteristic_count];
+        *ch = *characteristic;
+        builder->characteristic_lists[builder->characteristic_list_used] = ch;
+    }
+    builder->characteristic_count++;
+    builder->characteristic_list_used++;
+
+    // Type and description are string literals and are kept where they are,
+    // limits and callbacks usually come from compound literals on stack
+    #define copy_field(field, size) \
+        if (characteristic->field) { \
+            void *p = builder_copy(builder, characteristic->field, size); \
+            if (ch) ch->field = p; \
+        }
+
+    copy_field(min_value, sizeof(float));
+    copy_field(max_value, sizeof(float));
+    copy_field(min_step, sizeof(float));
+    copy_field(max_len, sizeof(int));
+    copy_field(max_data_len, sizeof(int));
+    copy_field(valid_values.values,
+               characteristic->valid_values.count * sizeof(*characteristic->valid_values.values));
+    copy_field(valid_values_ranges.ranges,
+               characteristic->valid_values_ranges.count * sizeof(*characteristic->valid_values_ranges.ranges));
+
+    #undef copy_field
+
+    homekit_characteristic_change_callback_t **next = ch ? &ch->callback : NULL;
+    for (homekit_characteristic_change_callback_t *callback = characteristic->callback;
+            callback; callback = callback->next) {
+        homekit_characteristic_change_callback_t *copy = builder_copy(builder, callback, sizeof(*callback));
+        if (next) {
+            *next = copy;
+            if (!copy)
+                break;
+            next = &copy->next;
+        }
+    }
+    if (next)
+        *next = NULL;
+
+    if (ch && ch->value.format == homekit_format_string) {
+        // String values are either literals or builder strings, neither
+        // of which may be freed
+        ch->value.is_static = true;
+    }
+
+    return ch;
+}
+
+
+char *accessory_builder_printf(accessory_builder_t *builder, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    int size = vsnprintf(NULL, 0, format, args) + 1;
+    va_end(args);
+
+    char *s = builder_alloc(builder, size);
+    if (s) {
+        va_start(args, format);
+        vsnprintf(s, size, format, args);
+        va_end(args);
+    }
+
+    return s;
+}
+
+
+homekit_accessory_t **accessory_builder_build(accessory_builder_fn build, void *context,
+                                              accessory_builder_stats_t *stats) {
+    accessory_builder_t builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.counting = true;
+
+    build(&builder, context);
+    builder_close_accessory(&builder);
+    if (builder.invalid)
+        return NULL;
+
+    accessory_builder_t sizes = builder;
+
+    size_t accessories_size = ACCESSORY_BUILDER_ALIGN(sizes.accessory_count * sizeof(homekit_accessory_t));
+    size_t services_size = ACCESSORY_BUILDER_ALIGN(sizes.service_count * sizeof(homekit_service_t));
+    size_t characteristics_size = ACCESSORY_BUILDER_ALIGN(sizes.characteristic_count * sizeof(homekit_characteristic_t));
+    size_t objects_size = accessories_size + services_size + characteristics_size;
+    size_t lists_size = ACCESSORY_BUILDER_ALIGN(
+        (sizes.accessory_count + 1 +
+         sizes.service_list_used +
+         sizes.characteristic_list_used) * sizeof(void*)
+    );
+    size_t arena_size = objects_size + lists_size + sizes.data_used;
+
+    uint8_t *arena = calloc(1, arena_size);
+    if (!arena)
+        return NULL;
+
+    memset(&builder, 0, sizeof(builder));
+    builder.accessories = (homekit_accessory_t*)arena;
+    builder.services = (homekit_service_t*)(arena + accessories_size);
+    builder.characteristics = (homekit_characteristic_t*)(arena + accessories_size + services_size);
+    builder.accessory_list = (homekit_accessory_t**)(arena + objects_size);
+    builder.service_lists = (homekit_service_t**)(builder.accessory_list + sizes.accessory_count + 1);
+    builder.characteristic_lists = (homekit_characteristic_t**)(builder.service_lists + sizes.service_list_used);
+    builder.data = arena + objects_size + lists_size;
+    builder.sizes = &sizes;
+
+    build(&builder, context);
+    builder_close_accessory(&builder);
+
+    if (builder.invalid ||
+            builder.accessory_count != sizes.accessory_count ||
+            builder.service_count != sizes.service_count ||
+            builder.characteristic_count != sizes.characteristic_count ||
+            builder.data_used != sizes.data_used) {
+        // Build function produced different objects in second run
+        free(arena);
+        return NULL;
+    }
+
+    builder.accessory_list[builder.accessory_count] = NULL;
+
+    if (stats) {
+        stats->bytes = arena_size;
+        stats->allocations = 1;
+        stats->objects = builder.accessory_count + builder.service_count + builder.characteristic_count;
+    }
+
+    return builder.accessory_list;
+}
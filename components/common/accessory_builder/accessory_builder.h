@@ -0,0 +1,76 @@
+/*
+ * Arena based builder for dynamically created accessories.
+ *
+ * NEW_HOMEKIT_ACCESSORY/SERVICE/CHARACTERISTIC clone every object and
+ * its strings into separate heap blocks. Builder instead lays out the
+ * whole accessory database in a single allocation:
+ *
+ * Build function describing accessories is run twice. First run only
+ * counts objects and bytes, then one arena of exact size is allocated
+ * and second run fills it. Objects are passed as templates, the same
+ * ones HOMEKIT_ACCESSORY(), HOMEKIT_SERVICE() and HOMEKIT_CHARACTERISTIC()
+ * produce. Their constant metadata (type UUID, description strings) is
+ * referenced, not copied, so it stays in flash. Data templates keep on
+ * stack (min/max values, valid values, callbacks) is copied to the arena.
+ *
+ * Build function has to produce the same objects in both runs and must
+ * not use pointers returned by builder in the first run (they are NULL).
+ * Linked services are not supported.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <homekit/types.h>
+
+typedef struct {
+    // Total arena size in bytes
+    size_t bytes;
+    // Number of heap allocations made
+    unsigned int allocations;
+    // Number of accessories, services and characteristics laid out
+    unsigned int objects;
+} accessory_builder_stats_t;
+
+typedef struct _accessory_builder accessory_builder_t;
+
+typedef void (*accessory_builder_fn)(accessory_builder_t *builder, void *context);
+
+/**
+    Builds accessory database.
+
+    @param build Function describing accessories
+    @param context Passed to build function
+    @param stats Optional, receives arena size and allocation count
+    @return NULL terminated array of accessories, suitable for
+            homekit_server_config_t, or NULL if there is not enough memory
+            or build function produced different objects in second run.
+*/
+homekit_accessory_t **accessory_builder_build(accessory_builder_fn build, void *context,
+                                              accessory_builder_stats_t *stats);
+
+/**
+    Starts new accessory, services added after it belong to it.
+    Template services field is ignored.
+*/
+homekit_accessory_t *accessory_builder_accessory(accessory_builder_t *builder,
+                                                 const homekit_accessory_t *accessory);
+
+/**
+    Starts new service in current accessory, characteristics added after
+    it belong to it. Template characteristics and linked fields are ignored.
+*/
+homekit_service_t *accessory_builder_service(accessory_builder_t *builder,
+                                             const homekit_service_t *service);
+
+/**
+    Adds characteristic to current service.
+*/
+homekit_characteristic_t *accessory_builder_characteristic(accessory_builder_t *builder,
+                                                           const homekit_characteristic_t *characteristic);
+
+/**
+    Formats a string into the arena, e.g. for accessory or service name.
+*/
+char *accessory_builder_printf(accessory_builder_t *builder, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
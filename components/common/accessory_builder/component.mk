@@ -0,0 +1,14 @@
+# Component makefile for accessory_builder
+
+ifdef component_compile_rules
+    # ESP-Open-RTOS
+    INC_DIRS += $(accessory_builder_ROOT)
+
+    accessory_builder_SRC_DIR = $(accessory_builder_ROOT)
+
+    $(eval $(call component_compile_rules,accessory_builder))
+else
+    # ESP-IDF
+    COMPONENT_SRCDIRS = .
+    COMPONENT_ADD_INCLUDEDIRS = .
+endif
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "characteristic_index.h"
+
+
+static uint32_t hash_id(uint16_t aid, uint16_t iid) {
+    // Multiplicative hash, low bits of the product do not depend on aid,
+    // so high bits are folded in before table mask is applied
+    uint32_t hash = (((uint32_t)aid << 16) | iid) * 2654435761u;
+    return hash ^ (hash >> 16);
+}
+
+
+static uint32_t hash_type(uint16_t aid, const char *service_type, const char *characteristic_type) {
+    // FNV-1a
+    uint32_t hash = 2166136261u ^ aid;
+    for (const char *s = service_type; *s; s++)
+        hash = (hash ^ (uint8_t)*s) * 16777619u;
+    hash = (hash ^ '/') * 16777619u;
+    for (const char *s = characteristic_type; *s; s++)
+        hash = (hash ^ (uint8_t)*s) * 16777619u;
+    return hash;
+}
+
+
+static bool entry_has_id(characteristic_index_entry_t *entry, uint16_t aid, uint16_t iid) {
+    return entry->aid == aid && entry->characteristic->id == iid;
+}
+
+
+static bool entry_has_type(characteristic_index_entry_t *entry, uint16_t aid,
+                           const char *service_type, const char *characteristic_type) {
+    return entry->aid == aid &&
+        !strcmp(entry->service->type, service_type) &&
+        !strcmp(entry->characteristic->type, characteristic_type);
+}
+
+
+int characteristic_index_init(characteristic_index_t *index, homekit_accessory_t **accessories) {
+    memset(index, 0, sizeof(*index));
+
+    uint32_t count = 0;
+    for (homekit_accessory_t **accessory = accessories; *accessory; accessory++)
+        for (homekit_service_t **service = (*accessory)->services; *service; service++)
+            for (homekit_characteristic_t **ch = (*service)->characteristics; *ch; ch++)
+                count++;
+
+    // Keep tables at most half full
+    uint32_t size = 4;
+    while (size < count * 2)
+        size *= 2;
+    if (count > UINT16_MAX - 1 || size > UINT16_MAX + 1)
+        return -1;
+
+    index->entries = malloc(count * sizeof(*index->entries));
+    index->by_id = calloc(size, sizeof(*index->by_id));
+    index->by_type = calloc(size, sizeof(*index->by_type));
+    if ((count && !index->entries) || !index->by_id || !index->by_type) {
+        characteristic_index_free(index);
+        return -1;
+    }
+    index->mask = size - 1;
+
+    for (homekit_accessory_t **accessory = accessories; *accessory; accessory++) {
+        uint16_t aid = (*accessory)->id;
+        for (homekit_service_t **service = (*accessory)->services; *service; service++) {
+            for (homekit_characteristic_t **ch = (*service)->characteristics; *ch; ch++) {
+                characteristic_index_entry_t *entry = &index->entries[index->count++];
+                entry->characteristic = *ch;
+                entry->service = *service;
+                entry->aid = aid;
+
+                uint32_t slot = hash_id(aid, (*ch)->id) & index->mask;
+                while (index->by_id[slot])
+                    slot = (slot + 1) & index->mask;
+                index->by_id[slot] = index->count;
+
+                // Only the first characteristic of a type is reachable by type,
+                // same as with homekit_service_by_type()
+                const char *service_type = (*service)->type;
+                slot = hash_type(aid, service_type, (*ch)->type) & index->mask;
+                while (index->by_type[slot] &&
+                        !entry_has_type(&index->entries[index->by_type[slot] - 1],
+                                        aid, service_type, (*ch)->type))
+                    slot = (slot + 1) & index->mask;
+                if (!index->by_type[slot])
+                    index->by_type[slot] = index->count;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+void characteristic_index_free(characteristic_index_t *index) {
+    free(index->entries);
+    free(index->by_id);
+    free(index->by_type);
+    memset(index, 0, sizeof(*index));
+}
+
+
+homekit_characteristic_t *characteristic_index_by_id(characteristic_index_t *index,
+                                                     uint16_t aid, uint16_t iid) {
+    if (!index->by_id)
+        return NULL;
+
+    uint32_t slot = hash_id(aid, iid) & index->mask;
+    while (index->by_id[slot]) {
+        characteristic_index_entry_t *entry = &index->entries[index->by_id[slot] - 1];
+        if (entry_has_id(entry, aid, iid))
+            return entry->characteristic;
+        slot = (slot + 1) & index->mask;
+    }
+
+    return NULL;
+}
+
+
+homekit_characteristic_t *characteristic_index_by_type(characteristic_index_t *index, uint16_t aid,
+                                                       const char *service_type,
+                                                       const char *characteristic_type) {
+    if (!index->by_type)
+        return NULL;
+
+    uint32_t slot = hash_type(aid, service_type, characteristic_type) & index->mask;
+    while (index->by_type[slot]) {
+        characteristic_index_entry_t *entry = &index->entries[index->by_type[slot] - 1];
+        if (entry_has_type(entry, aid, service_type, characteristic_type))
+            return entry->characteristic;
+        slot = (slot + 1) & index->mask;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,65 @@
+/*
+ * Hash index over accessory database characteristics.
+ *
+ * homekit_characteristic_by_aid_and_iid() and
+ * homekit_service_characteristic_by_type() walk the accessory tree on
+ * every call. Index is built once and resolves characteristics by
+ * (aid, iid) or by (aid, service type, characteristic type) through
+ * open addressing hash tables kept at most half full, so a lookup
+ * needs a few probes on average instead of a walk over the tree.
+ *
+ * Instance IDs are assigned by homekit_server_init(), so index has to be
+ * built after it. Returned pointers are the characteristics themselves and
+ * stay valid after the index is freed, so code that only needs a few
+ * handles can resolve them once and free the index right away.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <homekit/types.h>
+
+typedef struct {
+    homekit_characteristic_t *characteristic;
+    homekit_service_t *service;
+    uint16_t aid;
+} characteristic_index_entry_t;
+
+typedef struct {
+    characteristic_index_entry_t *entries;
+    uint16_t count;
+
+    // Open addressing tables of entry number + 1, zero marks empty slot
+    uint16_t *by_id;
+    uint16_t *by_type;
+    // Table size minus one, table size is power of two
+    uint16_t mask;
+} characteristic_index_t;
+
+/**
+    Builds index for all characteristics of accessories.
+
+    @param index Index to initialize
+    @param accessories NULL terminated array, already passed to homekit_server_init()
+    @return 0 on success, negative value if there is not enough memory
+*/
+int characteristic_index_init(characteristic_index_t *index, homekit_accessory_t **accessories);
+
+/**
+    Releases index memory.
+*/
+void characteristic_index_free(characteristic_index_t *index);
+
+/**
+    @return Characteristic with given accessory and instance IDs, or NULL
+*/
+homekit_characteristic_t *characteristic_index_by_id(characteristic_index_t *index,
+                                                     uint16_t aid, uint16_t iid);
+
+/**
+    @return Characteristic of given type in a service of given type of
+            accessory aid, or NULL. If there are several, the first one
+            in accessory order.
+*/
+homekit_characteristic_t *characteristic_index_by_type(characteristic_index_t *index, uint16_t aid,
+                                                       const char *service_type,
+                                                       const char *characteristic_type);
@@ -0,0 +1,14 @@
+# Component makefile for characteristic_index
+
+ifdef component_compile_rules
+    # ESP-Open-RTOS
+    INC_DIRS += $(characteristic_index_ROOT)
+
+    characteristic_index_SRC_DIR = $(characteristic_index_ROOT)
+
+    $(eval $(call component_compile_rules,characteristic_index))
+else
+    # ESP-IDF
+    COMPONENT_SRCDIRS = .
+    COMPONENT_ADD_INCLUDEDIRS = .
+endif
@@ -0,0 +1,367 @@
+#include <string.h>
+#include <esp/gpio.h>
+#include <etstimer.h>
+#include <esplibs/libmain.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include "actuator.h"
+
+
+typedef struct {
+    actuator_config_t config;
+
+    bool requested;
+    bool on;
+    // Request made inside batch, applied on commit
+    bool staged;
+    bool has_staged;
+    // time of last output change, in milliseconds
+    uint32_t changed;
+
+    actuator_stats_t stats;
+} actuator_t;
+
+
+static actuator_t actuators[ACTUATOR_MAX_CHANNELS];
+static uint8_t actuator_count = 0;
+
+// Batch belongs to the task that opened it, other tasks wait in
+// actuator_begin() until it is committed
+static SemaphoreHandle_t batch_lock = NULL;
+static TaskHandle_t batch_owner = NULL;
+static uint8_t batch_depth = 0;
+
+// Serializes applying changes and (re)arming the timer. Channel state
+// itself is only touched in critical sections, timer calls are made
+// outside of them.
+static SemaphoreHandle_t update_lock = NULL;
+static ETSTimer actuator_timer;
+static bool actuator_timer_armed = false;
+
+// Delay before timer retries an update it could not make, in milliseconds
+#define ACTUATOR_RETRY_TIME 10
+
+
+static inline uint32_t actuator_now() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+
+static inline bool actuator_elapsed(uint32_t since, uint32_t time, uint32_t now) {
+    return now - since >= time;
+}
+
+
+static void actuator_write(uint32_t set_mask, uint32_t clear_mask, bool gpio16, bool gpio16_level) {
+    // Clear first, so interlocked channel is released before its partner is energized
+    if (clear_mask)
+        GPIO.OUT_CLEAR = clear_mask;
+    if (set_mask)
+        GPIO.OUT_SET = set_mask;
+
+    // GPIO16 is not part of GPIO registers
+    if (gpio16)
+        gpio_write(16, gpio16_level);
+}
+
+
+// Applies changes that are due, returns time until next one or 0 if none
+static uint32_t actuator_apply(uint32_t now) {
+    uint32_t set_mask = 0, clear_mask = 0;
+    bool gpio16 = false, gpio16_level = false;
+    uint32_t next = 0;
+
+    #define schedule(time) if (!next || (time) < next) next = (time)
+
+    // Switch off first, this may allow other channels of the group on
+    for (int i = 0; i < actuator_count; i++) {
+        actuator_t *a = &actuators[i];
+        if (a->requested || !a->on)
+            continue;
+
+        if (!actuator_elapsed(a->changed, a->config.min_on_time, now)) {
+            schedule(a->config.min_on_time - (now - a->changed));
+            continue;
+        }
+
+        a->on = false;
+        a->changed = now;
+        a->stats.switches++;
+
+        bool level = a->config.active_low;
+        if (a->config.gpio == 16) {
+            gpio16 = true;
+            gpio16_level = level;
+        } else if (level) {
+            set_mask |= BIT(a->config.gpio);
+        } else {
+            clear_mask |= BIT(a->config.gpio);
+        }
+    }
+
+    for (int i = 0; i < actuator_count; i++) {
+        actuator_t *a = &actuators[i];
+        if (!a->requested || a->on)
+            continue;
+
+        uint32_t wait = 0;
+        if (!actuator_elapsed(a->changed, a->config.min_off_time, now))
+            wait = a->config.min_off_time - (now - a->changed);
+
+        bool blocked = false;
+        if (a->config.group != ACTUATOR_NO_GROUP) {
+            for (int j = 0; j < actuator_count; j++) {
+                actuator_t *other = &actuators[j];
+                if (other == a || other->config.group != a->config.group)
+                    continue;
+
+                if (other->on) {
+                    // Will be retried once other channel has gone off
+                    blocked = true;
+                    break;
+                }
+
+                if (!actuator_elapsed(other->changed, a->config.dead_time, now)) {
+                    uint32_t dead = a->config.dead_time - (now - other->changed);
+                    if (dead > wait)
+                        wait = dead;
+                }
+            }
+        }
+
+        if (blocked)
+            continue;
+
+        if (wait) {
+            schedule(wait);
+            continue;
+        }
+
+        a->on = true;
+        a->changed = now;
+        a->stats.switches++;
+
+        bool level = !a->config.active_low;
+        if (a->config.gpio == 16) {
+            gpio16 = true;
+            gpio16_level = level;
+        } else if (level) {
+            set_mask |= BIT(a->config.gpio);
+        } else {
+            clear_mask |= BIT(a->config.gpio);
+        }
+    }
+
+    #undef schedule
+
+    actuator_write(set_mask, clear_mask, gpio16, gpio16_level);
+
+    return next;
+}
+
+
+// Must be called with update_lock taken
+static void actuator_update_locked() {
+    taskENTER_CRITICAL();
+    uint32_t next = actuator_apply(actuator_now());
+    taskEXIT_CRITICAL();
+
+    if (actuator_timer_armed) {
+        sdk_os_timer_disarm(&actuator_timer);
+        actuator_timer_armed = false;
+    }
+    if (next) {
+        sdk_os_timer_arm(&actuator_timer, next, false);
+        actuator_timer_armed = true;
+    }
+}
+
+
+static void actuator_update() {
+    xSemaphoreTake(update_lock, portMAX_DELAY);
+    actuator_update_locked();
+    xSemaphoreGive(update_lock);
+}
+
+
+static void actuator_timer_callback(void *arg) {
+    // Timer callbacks share one task and must not block. If another task
+    // is in the middle of an update, retry shortly.
+    if (xSemaphoreTake(update_lock, 0) != pdTRUE) {
+        sdk_os_timer_arm(&actuator_timer, ACTUATOR_RETRY_TIME, false);
+        actuator_timer_armed = true;
+        return;
+    }
+
+    actuator_update_locked();
+    xSemaphoreGive(update_lock);
+}
+
+
+int actuator_add(const actuator_config_t *config) {
+    if (actuator_count >= ACTUATOR_MAX_CHANNELS || config->gpio > 16)
+        return -1;
+
+    if (!actuator_count) {
+        if (!update_lock)
+            update_lock = xSemaphoreCreateMutex();
+        if (!batch_lock)
+            batch_lock = xSemaphoreCreateRecursiveMutex();
+        if (!update_lock || !batch_lock)
+            return -1;
+
+        sdk_os_timer_setfn(&actuator_timer, actuator_timer_callback, NULL);
+    }
+
+    actuator_t *a = &actuators[actuator_count];
+    memset(a, 0, sizeof(*a));
+    a->config = *config;
+
+    // No minimum off time right after start
+    a->changed = actuator_now() - a->config.min_off_time - a->config.dead_time;
+
+    gpio_enable(config->gpio, GPIO_OUTPUT);
+    gpio_write(config->gpio, config->active_low);
+
+    return actuator_count++;
+}
+
+
+int actuator_find(const char *name) {
+    for (int i = 0; i < actuator_count; i++) {
+        if (actuators[i].config.name && !strcmp(actuators[i].config.name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+
+// Must be called in critical section
+static void actuator_request(int channel, bool on) {
+    actuator_t *a = &actuators[channel];
+    if (on && a->config.group != ACTUATOR_NO_GROUP) {
+        for (int i = 0; i < actuator_count; i++) {
+            if (i != channel && actuators[i].config.group == a->config.group)
+                actuators[i].requested = false;
+        }
+    }
+
+    if (a->requested != on) {
+        a->requested = on;
+        if (!on && a->on && !actuator_elapsed(a->changed, a->config.min_on_time, actuator_now()))
+            a->stats.delayed++;
+        if (on && !a->on && !actuator_elapsed(a->changed, a->config.min_off_time, actuator_now()))
+            a->stats.delayed++;
+    }
+}
+
+
+// Must be called in critical section
+static void actuator_stage(int channel, bool on) {
+    actuator_t *a = &actuators[channel];
+    if (on && a->config.group != ACTUATOR_NO_GROUP) {
+        for (int i = 0; i < actuator_count; i++) {
+            if (i != channel && actuators[i].config.group == a->config.group) {
+                actuators[i].staged = false;
+                actuators[i].has_staged = true;
+            }
+        }
+    }
+
+    a->staged = on;
+    a->has_staged = true;
+}
+
+
+void actuator_set(int channel, bool on) {
+    if (channel < 0 || channel >= actuator_count)
+        return;
+
+    taskENTER_CRITICAL();
+    if (batch_owner && batch_owner == xTaskGetCurrentTaskHandle()) {
+        actuator_stage(channel, on);
+        taskEXIT_CRITICAL();
+        return;
+    }
+
+    actuator_request(channel, on);
+    taskEXIT_CRITICAL();
+
+    actuator_update();
+}
+
+
+bool actuator_get(int channel) {
+    if (channel < 0 || channel >= actuator_count)
+        return false;
+
+    actuator_t *a = &actuators[channel];
+    if (a->has_staged && batch_owner == xTaskGetCurrentTaskHandle())
+        return a->staged;
+
+    return a->requested;
+}
+
+
+bool actuator_is_on(int channel) {
+    if (channel < 0 || channel >= actuator_count)
+        return false;
+
+    return actuators[channel].on;
+}
+
+
+void actuator_begin() {
+    xSemaphoreTakeRecursive(batch_lock, portMAX_DELAY);
+
+    taskENTER_CRITICAL();
+    batch_owner = xTaskGetCurrentTaskHandle();
+    batch_depth++;
+    taskEXIT_CRITICAL();
+}
+
+
+void actuator_commit() {
+    taskENTER_CRITICAL();
+    if (!batch_depth || batch_owner != xTaskGetCurrentTaskHandle()) {
+        taskEXIT_CRITICAL();
+        return;
+    }
+
+    bool apply = !--batch_depth;
+    if (apply) {
+        // Staged requests are consistent within groups, switching on
+        // last leaves exactly the staged channels of a group on
+        for (int i = 0; i < actuator_count; i++) {
+            if (actuators[i].has_staged && !actuators[i].staged)
+                actuator_request(i, false);
+        }
+        for (int i = 0; i < actuator_count; i++) {
+            if (actuators[i].has_staged && actuators[i].staged)
+                actuator_request(i, true);
+            actuators[i].has_staged = false;
+        }
+        batch_owner = NULL;
+    }
+    taskEXIT_CRITICAL();
+
+    if (apply)
+        actuator_update();
+
+    xSemaphoreGiveRecursive(batch_lock);
+}
+
+
+void actuator_get_stats(int channel, actuator_stats_t *stats) {
+    if (channel < 0 || channel >= actuator_count) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    *stats = actuators[channel].stats;
+    taskEXIT_CRITICAL();
+}
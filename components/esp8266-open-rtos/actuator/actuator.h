@@ -0,0 +1,85 @@
+/*
+ * Relay and other on/off actuator driver.
+ *
+ * Channels are switched by requesting a state, the driver decides when
+ * the output actually changes:
+ *  - channel stays on for at least min_on_time and off for at least
+ *    min_off_time, so a flapping request does not chatter the relay;
+ *  - channels in the same exclusion group are never on together, turning
+ *    one on turns others off, and it is only switched on dead_time after
+ *    the others went off (e.g. for motor direction reversal).
+ *
+ * Changes that become due at the same time are written to GPIO with
+ * a single register write. Delayed changes are applied from a timer.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ACTUATOR_MAX_CHANNELS 8
+
+// Exclusion group of channels that are independent
+#define ACTUATOR_NO_GROUP 0
+
+typedef struct {
+    const char *name;
+    uint8_t gpio;
+    // Output is low when channel is on
+    bool active_low;
+    // Channels with the same non zero group are never on together
+    uint8_t group;
+
+    // times in milliseconds
+    uint32_t min_on_time;
+    uint32_t min_off_time;
+    // Time between other channel of the group going off and this one going on
+    uint32_t dead_time;
+} actuator_config_t;
+
+typedef struct {
+    // Number of times output was switched on or off
+    uint32_t switches;
+    // Number of requests that had to be delayed by time limits
+    uint32_t delayed;
+} actuator_stats_t;
+
+/**
+    Adds a channel and switches its output off.
+
+    @param config Channel configuration
+    @return Channel number or a negative integer if this method fails.
+*/
+int actuator_add(const actuator_config_t *config);
+
+/**
+    Returns channel number for given name or a negative integer if there is none.
+*/
+int actuator_find(const char *name);
+
+/**
+    Requests channel to be switched on or off. Turning a grouped channel
+    on also requests all other channels of its group to be off.
+*/
+void actuator_set(int channel, bool on);
+
+/**
+    Returns requested state of a channel.
+*/
+bool actuator_get(int channel);
+
+/**
+    Returns actual output state of a channel.
+*/
+bool actuator_is_on(int channel);
+
+/**
+    Defers applying actuator_set() calls of the calling task until
+    actuator_commit(), so related changes (e.g. relay pair) are written
+    together. Can be nested. Requests of other tasks are applied right
+    away, only their own batches wait until this one is committed.
+*/
+void actuator_begin();
+void actuator_commit();
+
+void actuator_get_stats(int channel, actuator_stats_t *stats);
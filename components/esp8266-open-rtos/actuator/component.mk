@@ -0,0 +1,7 @@
+# Component makefile for actuator
+
+INC_DIRS += $(actuator_ROOT)
+
+actuator_SRC_DIR = $(actuator_ROOT)
+
+$(eval $(call component_compile_rules,actuator))
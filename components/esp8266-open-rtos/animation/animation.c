@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "animation.h"
+
+#ifdef ANIMATION_HOST
+
+#include <time.h>
+
+#define animation_mutex_take()
+#define animation_mutex_give()
+#define animation_wakeup()
+
+static uint32_t animation_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#else
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <espressif/esp_common.h>
+
+static SemaphoreHandle_t animation_mutex = NULL;
+static TaskHandle_t animation_task_handle = NULL;
+
+#define animation_mutex_take() xSemaphoreTakeRecursive(animation_mutex, portMAX_DELAY)
+#define animation_mutex_give() xSemaphoreGiveRecursive(animation_mutex)
+#define animation_wakeup() if (animation_task_handle) xTaskNotifyGive(animation_task_handle)
+#define animation_time_us() sdk_system_get_time()
+
+#endif
+
+
+static animation_t *animations = NULL;
+static animation_stats_t stats;
+
+
+void animation_lock() {
+    animation_mutex_take();
+}
+
+
+void animation_unlock() {
+    animation_mutex_give();
+}
+
+
+// Time until animation's next frame. Animation that has not rendered its
+// first frame since start is due right away, its deadline is not set yet.
+static inline uint32_t animation_wait(animation_t *animation, uint32_t now) {
+    if (animation->frame == 0)
+        return 0;
+    return (int32_t)(animation->deadline - now) > 0 ? animation->deadline - now : 0;
+}
+
+
+// Returns true if a should run before b
+static inline bool animation_before(animation_t *a, animation_t *b) {
+    if (a->frame == 0 || b->frame == 0)
+        return a->frame == 0 && b->frame != 0;
+    return (int32_t)(a->deadline - b->deadline) < 0;
+}
+
+
+// Animation is runnable unless there is a higher priority animation in its group
+static bool animation_runnable(animation_t *animation) {
+    for (animation_t *a = animations; a; a = a->next) {
+        if (a != animation && a->group == animation->group && a->priority > animation->priority)
+            return false;
+    }
+    return true;
+}
+
+
+static void animation_remove(animation_t *animation) {
+    animation_t **a = &animations;
+    while (*a) {
+        if (*a == animation) {
+            *a = animation->next;
+            break;
+        }
+        a = &(*a)->next;
+    }
+    animation->next = NULL;
+    animation->active = false;
+}
+
+
+static void animation_finish(animation_t *animation) {
+    animation_remove(animation);
+    if (animation->on_finish)
+        animation->on_finish(animation);
+}
+
+
+uint32_t animation_tick(uint32_t now) {
+    animation_lock();
+
+    stats.wakeups++;
+
+    // Animation list can change from step and finish callbacks,
+    // so the list is scanned again after every frame.
+    while (true) {
+        animation_t *animation = NULL;
+        for (animation_t *a = animations; a; a = a->next) {
+            if (animation_wait(a, now) || !animation_runnable(a))
+                continue;
+            if (!animation || animation_before(a, animation))
+                animation = a;
+        }
+        if (!animation)
+            break;
+
+        if (animation->frame == 0)
+            animation->started = now;
+        animation->elapsed = now - animation->started;
+
+        uint32_t start = animation_time_us();
+        int delay = animation->step(animation);
+        uint32_t frame_time = animation_time_us() - start;
+
+        animation->frame++;
+        animation->frame_time_total += frame_time;
+        if (frame_time > animation->frame_time_max)
+            animation->frame_time_max = frame_time;
+
+        stats.frames++;
+        stats.frame_time_total += frame_time;
+        if (frame_time > stats.frame_time_max)
+            stats.frame_time_max = frame_time;
+
+        if (delay == ANIMATION_DONE) {
+            animation_finish(animation);
+        } else {
+            animation->deadline = now + (delay > 0 ? delay : 1);
+        }
+    }
+
+    uint32_t next = ANIMATION_IDLE;
+    for (animation_t *a = animations; a; a = a->next) {
+        if (!animation_runnable(a))
+            continue;
+
+        uint32_t wait = animation_wait(a, now);
+        if (wait < next)
+            next = wait;
+    }
+
+    animation_unlock();
+
+    return next;
+}
+
+
+#ifndef ANIMATION_HOST
+
+static void animation_task(void *_args) {
+    TickType_t wait = portMAX_DELAY;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        uint32_t next = animation_tick(xTaskGetTickCount() * portTICK_PERIOD_MS);
+        if (next == ANIMATION_IDLE) {
+            wait = portMAX_DELAY;
+        } else {
+            wait = (next + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+            if (!wait)
+                wait = 1;
+        }
+    }
+}
+
+
+int animation_init() {
+    if (animation_task_handle)
+        return 0;
+
+    animation_mutex = xSemaphoreCreateRecursiveMutex();
+    if (!animation_mutex)
+        return -1;
+
+    if (xTaskCreate(animation_task, "Animation", 512, NULL, 2, &animation_task_handle) != pdPASS) {
+        animation_task_handle = NULL;
+        vSemaphoreDelete(animation_mutex);
+        animation_mutex = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+#else
+
+int animation_init() {
+    return 0;
+}
+
+#endif
+
+
+void animation_start(animation_t *animation) {
+    animation_lock();
+
+    if (animation->active)
+        animation_remove(animation);
+
+    animation->active = true;
+    // Frame 0 makes it due on the next tick, whatever the current time is
+    animation->frame = 0;
+    animation->next = animations;
+    animations = animation;
+
+    animation_unlock();
+
+    animation_wakeup();
+}
+
+
+void animation_stop(animation_t *animation) {
+    animation_lock();
+
+    if (animation->active)
+        animation_finish(animation);
+
+    animation_unlock();
+
+    animation_wakeup();
+}
+
+
+bool animation_is_active(animation_t *animation) {
+    return animation->active;
+}
+
+
+void animation_get_stats(animation_stats_t *s) {
+    animation_lock();
+    *s = stats;
+    animation_unlock();
+}
+
+
+static int animation_sequence_step(animation_t *animation) {
+    animation_sequence_t *sequence = (animation_sequence_t*) animation;
+
+    if (animation->frame >= sequence->keyframe_count * sequence->repeat)
+        return ANIMATION_DONE;
+
+    const animation_keyframe_t *keyframe =
+        &sequence->keyframes[animation->frame % sequence->keyframe_count];
+    sequence->apply(keyframe->value, animation->context);
+
+    return keyframe->duration;
+}
+
+
+void animation_sequence_init(animation_sequence_t *sequence,
+                             const animation_keyframe_t *keyframes, uint8_t keyframe_count,
+                             uint8_t repeat, animation_apply_fn apply, void *context) {
+    memset(sequence, 0, sizeof(*sequence));
+    sequence->animation.step = animation_sequence_step;
+    sequence->animation.context = context;
+    sequence->keyframes = keyframes;
+    sequence->keyframe_count = keyframe_count;
+    sequence->repeat = repeat;
+    sequence->apply = apply;
+}
@@ -0,0 +1,128 @@
+/*
+ * Cooperative animation scheduler.
+ *
+ * All animations run from a single task which sleeps until the nearest
+ * animation deadline. Animation is a state machine: scheduler calls its
+ * step function, which renders one frame and returns time until the next
+ * one.
+ *
+ * Animations in the same group share an output (e.g. an LED strip).
+ * Only the highest priority active animation in a group runs, lower
+ * priority ones are paused and continue when it finishes.
+ *
+ * Building with ANIMATION_HOST defined leaves out the task, so scheduler
+ * can be driven on a host by calling animation_tick() with simulated time.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Returned by step function when animation is complete
+#define ANIMATION_DONE -1
+// Returned by animation_tick() when there is nothing to run
+#define ANIMATION_IDLE UINT32_MAX
+
+typedef struct _animation animation_t;
+
+/**
+    Renders next frame of animation.
+
+    @param animation Animation, animation->frame is the frame number starting from 0
+    @return Delay in milliseconds until next frame or ANIMATION_DONE
+*/
+typedef int (*animation_step_fn)(animation_t *animation);
+
+typedef void (*animation_callback_fn)(animation_t *animation);
+
+struct _animation {
+    animation_step_fn step;
+    // Called when animation completes or is stopped
+    animation_callback_fn on_finish;
+    void *context;
+    uint8_t group;
+    uint8_t priority;
+
+    // Scheduler state
+    bool active;
+    uint32_t frame;
+    uint32_t deadline;
+    uint32_t started;
+    // Time since the first frame, in milliseconds
+    uint32_t elapsed;
+
+    // Per-frame CPU time, in microseconds
+    uint32_t frame_time_max;
+    uint32_t frame_time_total;
+
+    animation_t *next;
+};
+
+typedef struct {
+    uint32_t wakeups;
+    uint32_t frames;
+    uint32_t frame_time_max;
+    uint32_t frame_time_total;
+} animation_stats_t;
+
+/**
+    Starts scheduler task.
+
+    @return A negative integer if this method fails.
+*/
+int animation_init();
+
+/**
+    Starts animation from the first frame. Restarts it if already active.
+*/
+void animation_start(animation_t *animation);
+
+/**
+    Stops animation. on_finish callback is called if animation was active.
+*/
+void animation_stop(animation_t *animation);
+
+bool animation_is_active(animation_t *animation);
+
+/**
+    Locks animation state, so data used by step functions
+    can be safely modified from other tasks. Locks are recursive.
+*/
+void animation_lock();
+void animation_unlock();
+
+/**
+    Runs all animations that are due.
+
+    @param now Current time in milliseconds
+    @return Time in milliseconds until next deadline or ANIMATION_IDLE
+*/
+uint32_t animation_tick(uint32_t now);
+
+void animation_get_stats(animation_stats_t *stats);
+
+
+typedef struct {
+    uint32_t value;
+    // Time to hold the value, in milliseconds
+    uint16_t duration;
+} animation_keyframe_t;
+
+typedef void (*animation_apply_fn)(uint32_t value, void *context);
+
+typedef struct {
+    animation_t animation;
+
+    const animation_keyframe_t *keyframes;
+    uint8_t keyframe_count;
+    uint8_t repeat;
+    animation_apply_fn apply;
+} animation_sequence_t;
+
+/**
+    Initializes animation that plays keyframes (e.g. blink pattern) given number of times.
+    Sequence is started with animation_start(&sequence->animation).
+*/
+void animation_sequence_init(animation_sequence_t *sequence,
+                             const animation_keyframe_t *keyframes, uint8_t keyframe_count,
+                             uint8_t repeat, animation_apply_fn apply, void *context);
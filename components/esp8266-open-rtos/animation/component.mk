@@ -0,0 +1,7 @@
+# Component makefile for animation
+
+INC_DIRS += $(animation_ROOT)
+
+animation_SRC_DIR = $(animation_ROOT)
+
+$(eval $(call component_compile_rules,animation))
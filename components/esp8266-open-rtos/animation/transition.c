@@ -0,0 +1,105 @@
+#include <string.h>
+
+#include "transition.h"
+
+
+// Returns transition progress in 0-65536 range
+static uint32_t transition_progress(transition_t *transition) {
+    uint32_t elapsed = transition->animation.elapsed;
+    uint32_t duration = transition->config.duration;
+    if (!duration || elapsed >= duration)
+        return 65536;
+
+    uint32_t p = (elapsed << 16) / duration;
+    if (transition->config.easing == transition_easing_ease_in_out) {
+        // p^2 * (3 - 2p)
+        uint32_t p2 = (p * p) >> 16;
+        p = ((uint64_t)p2 * (3 * 65536 - 2 * p)) >> 16;
+    }
+
+    return p;
+}
+
+
+static int transition_step(animation_t *animation) {
+    transition_t *transition = (transition_t*) animation;
+    const transition_config_t *config = &transition->config;
+
+    uint16_t values[TRANSITION_MAX_CHANNELS];
+    bool changed = false;
+    bool done = true;
+
+    uint32_t p = 0;
+    if (config->easing != transition_easing_lpf)
+        p = transition_progress(transition);
+
+    for (int i = 0; i < config->channels; i++) {
+        int32_t from = transition->from[i];
+        int32_t to = transition->to[i];
+        int32_t value = transition->current[i];
+
+        if (config->easing == transition_easing_lpf) {
+            int32_t delta = (to - value) >> config->lpf_shift;
+            // Snap to target when remaining distance is too small to move
+            value = delta ? value + delta : to;
+        } else {
+            value = from + (((to - from) * (int64_t)p) >> 16);
+        }
+
+        values[i] = value;
+        if (values[i] != transition->current[i])
+            changed = true;
+        if (values[i] != transition->to[i])
+            done = false;
+    }
+
+    if (changed) {
+        memcpy(transition->current, values, sizeof(uint16_t) * config->channels);
+        config->apply(transition->current, config->context);
+    }
+
+    return done ? ANIMATION_DONE : config->interval;
+}
+
+
+void transition_init(transition_t *transition, const transition_config_t *config) {
+    memset(transition, 0, sizeof(*transition));
+    transition->config = *config;
+    if (transition->config.channels > TRANSITION_MAX_CHANNELS)
+        transition->config.channels = TRANSITION_MAX_CHANNELS;
+    if (!transition->config.interval)
+        transition->config.interval = 1;
+
+    transition->animation.step = transition_step;
+    transition->animation.context = transition;
+}
+
+
+void transition_set(transition_t *transition, const uint16_t *values) {
+    size_t size = sizeof(uint16_t) * transition->config.channels;
+
+    animation_lock();
+
+    if (memcmp(transition->to, values, size)) {
+        memcpy(transition->from, transition->current, size);
+        memcpy(transition->to, values, size);
+        animation_start(&transition->animation);
+    }
+
+    animation_unlock();
+}
+
+
+void transition_jump(transition_t *transition, const uint16_t *values) {
+    size_t size = sizeof(uint16_t) * transition->config.channels;
+
+    animation_lock();
+
+    animation_stop(&transition->animation);
+    memcpy(transition->from, values, size);
+    memcpy(transition->to, values, size);
+    memcpy(transition->current, values, size);
+    transition->config.apply(transition->current, transition->config.context);
+
+    animation_unlock();
+}
@@ -0,0 +1,61 @@
+/*
+ * Smooth transitions of multi-channel values (e.g. PWM duties)
+ * driven by the animation scheduler.
+ *
+ * Transition runs only while values are moving towards the target,
+ * so an idle light does not wake up the scheduler.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "animation.h"
+
+#define TRANSITION_MAX_CHANNELS 4
+
+typedef enum {
+    // Constant speed over transition duration
+    transition_easing_linear,
+    // Starts and ends slowly (smoothstep) over transition duration
+    transition_easing_ease_in_out,
+    // Moves by 1/2^lpf_shift of remaining distance every interval
+    transition_easing_lpf,
+} transition_easing_t;
+
+typedef void (*transition_apply_fn)(const uint16_t *values, void *context);
+
+typedef struct {
+    transition_easing_t easing;
+    // Transition duration (linear and ease in/out), in milliseconds
+    uint16_t duration;
+    // Time between two updates, in milliseconds
+    uint16_t interval;
+    uint8_t lpf_shift;
+    uint8_t channels;
+    // Called with new values every time they change
+    transition_apply_fn apply;
+    void *context;
+} transition_config_t;
+
+typedef struct {
+    animation_t animation;
+    transition_config_t config;
+
+    uint16_t from[TRANSITION_MAX_CHANNELS];
+    uint16_t to[TRANSITION_MAX_CHANNELS];
+    uint16_t current[TRANSITION_MAX_CHANNELS];
+} transition_t;
+
+void transition_init(transition_t *transition, const transition_config_t *config);
+
+/**
+    Starts transition from current values to given target.
+    Does nothing if target is the same as current target.
+
+    @param values Target values, one per channel
+*/
+void transition_set(transition_t *transition, const uint16_t *values);
+
+/**
+    Sets values immediately, without transition.
+*/
+void transition_jump(transition_t *transition, const uint16_t *values);
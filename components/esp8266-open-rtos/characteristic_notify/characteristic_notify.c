@@ -0,0 +1,153 @@
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <esplibs/libmain.h>
+#include <homekit/homekit.h>
+
+#include "characteristic_notify.h"
+
+
+static bool value_to_float(const homekit_value_t *value, float *result) {
+    switch (value->format) {
+        case homekit_format_bool:
+            *result = value->bool_value;
+            return true;
+        case homekit_format_uint8:
+            *result = value->uint8_value;
+            return true;
+        case homekit_format_uint16:
+            *result = value->uint16_value;
+            return true;
+        case homekit_format_uint32:
+            *result = value->uint32_value;
+            return true;
+        case homekit_format_int:
+            *result = value->int_value;
+            return true;
+        case homekit_format_float:
+            *result = value->float_value;
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+// Returns true if values are closer than dead_band or equal
+static bool value_close(const homekit_value_t *a, const homekit_value_t *b, float dead_band) {
+    if (a->is_null || b->is_null)
+        return a->is_null == b->is_null;
+
+    if (a->format != b->format)
+        return false;
+
+    float x, y;
+    if (value_to_float(a, &x) && value_to_float(b, &y)) {
+        float diff = (x > y) ? x - y : y - x;
+        return diff == 0 || diff < dead_band;
+    }
+
+    if (a->format == homekit_format_string)
+        return a->string_value && b->string_value && !strcmp(a->string_value, b->string_value);
+
+    return false;
+}
+
+
+static uint32_t now_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+
+static void characteristic_notify_send(characteristic_notify_t *notify, homekit_value_t value) {
+    notify->stats.sent++;
+    homekit_characteristic_notify(notify->characteristic, value);
+}
+
+
+static void characteristic_notify_timer(void *arg) {
+    characteristic_notify_t *notify = arg;
+
+    taskENTER_CRITICAL();
+    notify->pending = false;
+    homekit_value_t value = notify->value;
+    // Dead band only filters immediate sends, held back value is the
+    // final one and is dropped only if nothing changed
+    if (value_close(&notify->last_value, &value, 0)) {
+        taskEXIT_CRITICAL();
+        return;
+    }
+    notify->last_value = value;
+    notify->last_time = now_ms();
+    taskEXIT_CRITICAL();
+
+    characteristic_notify_send(notify, value);
+}
+
+
+void characteristic_notify_init(characteristic_notify_t *notify,
+                                homekit_characteristic_t *characteristic,
+                                const characteristic_notify_config_t *config) {
+    memset(notify, 0, sizeof(*notify));
+    notify->characteristic = characteristic;
+    notify->config = *config;
+
+    sdk_os_timer_setfn(&notify->timer, characteristic_notify_timer, notify);
+}
+
+
+void characteristic_notify(characteristic_notify_t *notify, homekit_value_t value) {
+    taskENTER_CRITICAL();
+    notify->stats.requested++;
+    notify->has_value = true;
+    notify->value = value;
+
+    if (notify->sent) {
+        if (notify->pending ||
+                value_close(&notify->last_value, &value, notify->config.dead_band)) {
+            taskEXIT_CRITICAL();
+            return;
+        }
+
+        uint32_t elapsed = now_ms() - notify->last_time;
+        if (elapsed < notify->config.min_interval) {
+            // Pending flag makes this the only caller arming timer,
+            // timer code is not run with interrupts disabled
+            notify->pending = true;
+            taskEXIT_CRITICAL();
+            sdk_os_timer_arm(&notify->timer, notify->config.min_interval - elapsed, false);
+            return;
+        }
+    }
+
+    notify->sent = true;
+    notify->last_value = value;
+    notify->last_time = now_ms();
+    taskEXIT_CRITICAL();
+
+    characteristic_notify_send(notify, value);
+}
+
+
+void characteristic_notify_flush(characteristic_notify_t *notify) {
+    taskENTER_CRITICAL();
+    bool pending = notify->pending;
+    notify->pending = false;
+
+    homekit_value_t value = notify->value;
+    bool send = notify->has_value && !(notify->sent && value_close(&notify->last_value, &value, 0));
+    if (send) {
+        notify->sent = true;
+        notify->last_value = value;
+        notify->last_time = now_ms();
+    }
+    taskEXIT_CRITICAL();
+
+    // If timer fires before it is disarmed, it finds latest value
+    // already sent and does nothing
+    if (pending)
+        sdk_os_timer_disarm(&notify->timer);
+
+    if (send)
+        characteristic_notify_send(notify, value);
+}
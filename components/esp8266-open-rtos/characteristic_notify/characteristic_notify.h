@@ -0,0 +1,71 @@
+/*
+ * Rate limiting wrapper for homekit_characteristic_notify().
+ *
+ * Values equal to the last sent one, or closer to it than dead band,
+ * are dropped. Values coming faster than min_interval are held back
+ * and only the latest of them is sent when the interval expires,
+ * unless it equals the last sent one. Dead band is not applied then,
+ * so the final value of a burst always reaches controllers.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <etstimer.h>
+#include <homekit/types.h>
+
+typedef struct {
+    // Minimum time between two notifications, in milliseconds
+    uint32_t min_interval;
+    // Numeric values closer than this to the last sent one are dropped
+    float dead_band;
+} characteristic_notify_config_t;
+
+typedef struct {
+    uint32_t requested;
+    uint32_t sent;
+} characteristic_notify_stats_t;
+
+typedef struct {
+    homekit_characteristic_t *characteristic;
+    characteristic_notify_config_t config;
+
+    // Latest requested value
+    bool has_value;
+    homekit_value_t value;
+
+    // Last sent value
+    bool sent;
+    homekit_value_t last_value;
+    // time in milliseconds
+    uint32_t last_time;
+
+    // Timer is armed to send latest value once min_interval expires
+    bool pending;
+    ETSTimer timer;
+
+    characteristic_notify_stats_t stats;
+} characteristic_notify_t;
+
+/**
+    Initializes notification limiter for a characteristic.
+
+    @param notify Limiter state
+    @param characteristic Characteristic to send notifications for
+    @param config Limits, zero min_interval and dead_band only drop repeated values
+*/
+void characteristic_notify_init(characteristic_notify_t *notify,
+                                homekit_characteristic_t *characteristic,
+                                const characteristic_notify_config_t *config);
+
+/**
+    Sends notification with value, unless it is dropped or delayed by limits.
+*/
+void characteristic_notify(characteristic_notify_t *notify, homekit_value_t value);
+
+/**
+    Sends latest value right away if it differs from the last sent one,
+    even when within dead band, e.g. when motion has stopped and exact
+    final value should be reported.
+*/
+void characteristic_notify_flush(characteristic_notify_t *notify);
@@ -0,0 +1,7 @@
+# Component makefile for characteristic_notify
+
+INC_DIRS += $(characteristic_notify_ROOT)
+
+characteristic_notify_SRC_DIR = $(characteristic_notify_ROOT)
+
+$(eval $(call component_compile_rules,characteristic_notify))
@@ -0,0 +1,7 @@
+# Component makefile for cover
+
+INC_DIRS += $(cover_ROOT)
+
+cover_SRC_DIR = $(cover_ROOT)
+
+$(eval $(call component_compile_rules,cover))
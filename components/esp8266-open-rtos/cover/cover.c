@@ -0,0 +1,322 @@
+#include <string.h>
+
+#include "cover.h"
+
+#ifdef COVER_HOST
+
+#define cover_lock()
+#define cover_unlock()
+#define cover_wakeup()
+#define cover_now() cover_host_now()
+
+#else
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+static SemaphoreHandle_t cover_mutex = NULL;
+static TaskHandle_t cover_task_handle = NULL;
+
+#define cover_lock() xSemaphoreTakeRecursive(cover_mutex, portMAX_DELAY)
+#define cover_unlock() xSemaphoreGiveRecursive(cover_mutex)
+#define cover_wakeup() if (cover_task_handle) xTaskNotifyGive(cover_task_handle)
+#define cover_now() (xTaskGetTickCount() * portTICK_PERIOD_MS)
+
+#endif
+
+
+static cover_t *covers = NULL;
+
+
+static inline uint8_t cover_percent(uint32_t position) {
+    return (position + COVER_POSITION_SCALE / 2) / COVER_POSITION_SCALE;
+}
+
+
+static inline uint32_t cover_travel_time(cover_t *cover, cover_state_t state) {
+    return (state == cover_state_opening) ? cover->config.open_time : cover->config.close_time;
+}
+
+
+// Position of moving cover, given time since motor start
+static uint32_t cover_position_after(cover_t *cover, int32_t elapsed) {
+    int32_t moving = elapsed - cover->config.start_lag;
+    if (moving <= 0)
+        return cover->start_position;
+
+    uint32_t travel = cover_travel_time(cover, cover->state);
+    uint64_t distance = (uint64_t)moving * COVER_POSITION_MAX / travel;
+
+    if (cover->state == cover_state_opening) {
+        uint64_t position = cover->start_position + distance;
+        return position < COVER_POSITION_MAX ? position : COVER_POSITION_MAX;
+    }
+
+    return distance < cover->start_position ? cover->start_position - distance : 0;
+}
+
+
+// Motor run time, from motor start, for moving cover to its target
+static uint32_t cover_run_time(cover_t *cover) {
+    uint32_t distance = (cover->target > cover->start_position)
+        ? cover->target - cover->start_position
+        : cover->start_position - cover->target;
+
+    uint32_t travel = cover_travel_time(cover, cover->state);
+    uint32_t moving = ((uint64_t)distance * travel + COVER_POSITION_MAX - 1) / COVER_POSITION_MAX;
+
+    int32_t run = cover->config.start_lag + moving - cover->config.stop_lag;
+    if (cover->target == 0 || cover->target == COVER_POSITION_MAX)
+        run += cover->config.end_stop_time;
+
+    return run > 0 ? run : 0;
+}
+
+
+// Time when reported position of moving cover changes next
+static uint32_t cover_next_percent_time(cover_t *cover) {
+    // Reported position is rounded, so it changes half way between whole percents
+    uint8_t percent = cover_percent(cover->position);
+    if (percent == (cover->state == cover_state_opening ? 100 : 0))
+        return cover->stop_time;
+
+    uint32_t boundary = percent * COVER_POSITION_SCALE;
+    uint32_t distance;
+    if (cover->state == cover_state_opening) {
+        boundary += COVER_POSITION_SCALE / 2;
+        distance = boundary - cover->start_position;
+    } else {
+        boundary -= COVER_POSITION_SCALE / 2;
+        distance = cover->start_position - boundary + 1;
+    }
+
+    uint32_t travel = cover_travel_time(cover, cover->state);
+    uint32_t moving = ((uint64_t)distance * travel + COVER_POSITION_MAX - 1) / COVER_POSITION_MAX;
+
+    return cover->start_time + cover->config.start_lag + moving;
+}
+
+
+static void cover_report(cover_t *cover, bool force) {
+    uint8_t percent = cover_percent(cover->position);
+    if (!force && percent == cover->reported)
+        return;
+
+    cover->reported = percent;
+    if (cover->config.on_change)
+        cover->config.on_change(cover);
+}
+
+
+// Stops motor, position includes coasting for stop_lag
+static void cover_halt(cover_t *cover, uint32_t now) {
+    if (cover->state == cover_state_stopped)
+        return;
+
+    cover->config.motor(cover, cover_state_stopped);
+
+    int32_t elapsed = now - cover->start_time;
+    if (elapsed >= cover->config.start_lag)
+        elapsed += cover->config.stop_lag;
+    cover->position = cover_position_after(cover, elapsed);
+
+    cover->halted_state = cover->state;
+    cover->halt_time = now;
+    cover->state = cover_state_stopped;
+}
+
+
+static void cover_finish(cover_t *cover) {
+    cover_halt(cover, cover->stop_time);
+
+    if (cover->target == 0 || cover->target == COVER_POSITION_MAX) {
+        // Motor was run into the end stop, so position is known exactly
+        cover->position = cover->target;
+    }
+    cover->target = cover->position;
+
+    cover_report(cover, true);
+}
+
+
+uint32_t cover_tick(uint32_t now) {
+    uint32_t next = COVER_IDLE;
+
+    cover_lock();
+
+    for (cover_t *cover = covers; cover; cover = cover->next) {
+        if (cover->state == cover_state_stopped)
+            continue;
+
+        int32_t remaining = cover->stop_time - now;
+        if (remaining <= 0) {
+            cover_finish(cover);
+            continue;
+        }
+
+        cover->position = cover_position_after(cover, now - cover->start_time);
+        cover_report(cover, false);
+
+        // Wake up for motor stop or next whole percent, whichever is first
+        uint32_t wait = cover_next_percent_time(cover) - now;
+        if ((int32_t)wait <= 0)
+            wait = 1;
+        if (wait > remaining)
+            wait = remaining;
+        if (wait < next)
+            next = wait;
+    }
+
+    cover_unlock();
+
+    return next;
+}
+
+
+#ifndef COVER_HOST
+
+static void cover_task(void *_args) {
+    TickType_t wait = portMAX_DELAY;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        uint32_t next = cover_tick(cover_now());
+        if (next == COVER_IDLE) {
+            wait = portMAX_DELAY;
+        } else {
+            wait = (next + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+            if (!wait)
+                wait = 1;
+        }
+    }
+}
+
+
+int cover_init() {
+    if (cover_task_handle)
+        return 0;
+
+    cover_mutex = xSemaphoreCreateRecursiveMutex();
+    if (!cover_mutex)
+        return -1;
+
+    if (xTaskCreate(cover_task, "Cover", 512, NULL, 2, &cover_task_handle) != pdPASS) {
+        cover_task_handle = NULL;
+        vSemaphoreDelete(cover_mutex);
+        cover_mutex = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+#else
+
+int cover_init() {
+    return 0;
+}
+
+#endif
+
+
+int cover_add(cover_t *cover, const cover_config_t *config, uint8_t position) {
+    if (!config->motor || !config->open_time || !config->close_time || position > 100)
+        return -1;
+
+    if (cover_init())
+        return -2;
+
+    memset(cover, 0, sizeof(*cover));
+    cover->config = *config;
+    cover->state = cover_state_stopped;
+    cover->position = cover->target = position * COVER_POSITION_SCALE;
+    cover->halted_state = cover_state_stopped;
+    cover->reported = position;
+
+    cover_lock();
+    cover->next = covers;
+    covers = cover;
+    cover_unlock();
+
+    return 0;
+}
+
+
+void cover_set_target(cover_t *cover, uint8_t target) {
+    if (target > 100)
+        target = 100;
+
+    cover_lock();
+
+    uint32_t now = cover_now();
+    if (cover->state != cover_state_stopped)
+        cover->position = cover_position_after(cover, now - cover->start_time);
+
+    cover->target = target * COVER_POSITION_SCALE;
+
+    cover_state_t state = cover_state_stopped;
+    if (cover->target > cover->position)
+        state = cover_state_opening;
+    else if (cover->target < cover->position)
+        state = cover_state_closing;
+
+    bool changed = (state != cover->state);
+    if (changed) {
+        cover_halt(cover, now);
+
+        if (state != cover_state_stopped) {
+            cover->state = state;
+            cover->start_position = cover->position;
+            cover->start_time = now;
+
+            int32_t halted = now - cover->halt_time;
+            if (cover->halted_state != cover_state_stopped && cover->halted_state != state &&
+                    halted < cover->config.reverse_delay) {
+                // Motor driver holds reversal back, so the move starts later
+                cover->start_time = cover->halt_time + cover->config.reverse_delay;
+            }
+
+            cover->config.motor(cover, state);
+        }
+    }
+
+    if (cover->state != cover_state_stopped) {
+        // Same direction keeps move start, so start lag is not counted twice
+        cover->stop_time = cover->start_time + cover_run_time(cover);
+    } else {
+        cover->target = cover->position;
+    }
+
+    cover_report(cover, changed);
+
+    cover_unlock();
+
+    cover_wakeup();
+}
+
+
+void cover_stop(cover_t *cover) {
+    cover_lock();
+
+    cover_halt(cover, cover_now());
+    cover->target = cover->position;
+    cover_report(cover, true);
+
+    cover_unlock();
+}
+
+
+uint8_t cover_get_position(cover_t *cover) {
+    return cover_percent(cover->position);
+}
+
+
+uint8_t cover_get_target(cover_t *cover) {
+    return cover_percent(cover->target);
+}
+
+
+cover_state_t cover_get_state(cover_t *cover) {
+    return cover->state;
+}
@@ -0,0 +1,146 @@
+/*
+ * Time based position tracking for motorized covers (blinds, curtains)
+ * without position feedback.
+ *
+ * Position is calculated from the time the motor has been running since
+ * the start of a move, in fixed point with COVER_POSITION_SCALE steps per
+ * percent, so rounding errors do not add up over updates. Motor start and
+ * stop lag are compensated when planning when to stop the motor. Moves to
+ * fully open or closed run the motor a bit longer and then reset position
+ * to the end stop, which removes error accumulated by partial moves.
+ * Motor drivers that hold a reversal back (e.g. relay dead time) are
+ * accounted for by starting the reversed move once reverse_delay after
+ * the motor stopped.
+ *
+ * All covers are run by a single task which sleeps until the next
+ * position change or motor stop.
+ *
+ * Building with COVER_HOST defined leaves out the task; cover_host_now()
+ * has to be provided and cover_tick() called with simulated time.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define COVER_POSITION_SCALE 65536
+#define COVER_POSITION_MAX (100 * COVER_POSITION_SCALE)
+
+// Returned by cover_tick() when no cover is moving
+#define COVER_IDLE UINT32_MAX
+
+// Values match HomeKit POSITION_STATE characteristic
+typedef enum {
+    cover_state_closing = 0,
+    cover_state_opening = 1,
+    cover_state_stopped = 2,
+} cover_state_t;
+
+typedef struct _cover cover_t;
+
+/**
+    Drives the motor.
+
+    @param cover Cover to drive
+    @param state Direction to run the motor in, or cover_state_stopped to stop it
+*/
+typedef void (*cover_motor_fn)(cover_t *cover, cover_state_t state);
+
+/**
+    Called when cover state or whole percent of position changes.
+*/
+typedef void (*cover_callback_fn)(cover_t *cover);
+
+typedef struct {
+    // Time to travel from fully closed to fully open, in milliseconds
+    uint32_t open_time;
+    // Time to travel from fully open to fully closed, in milliseconds
+    uint32_t close_time;
+    // Time from motor start until cover starts moving, in milliseconds
+    uint16_t start_lag;
+    // Time cover keeps moving after motor stop, in milliseconds
+    uint16_t stop_lag;
+    // Extra motor run time on moves to end stops, in milliseconds
+    uint16_t end_stop_time;
+    // Time motor driver waits after stop before running the other way, in milliseconds
+    uint16_t reverse_delay;
+
+    cover_motor_fn motor;
+    cover_callback_fn on_change;
+    void *context;
+} cover_config_t;
+
+struct _cover {
+    cover_config_t config;
+
+    cover_state_t state;
+    // Fixed point, COVER_POSITION_SCALE steps per percent
+    uint32_t position;
+    uint32_t target;
+
+    // Current move, times in milliseconds
+    uint32_t start_position;
+    uint32_t start_time;
+    uint32_t stop_time;
+
+    // Direction and time of the last motor stop, for reverse_delay
+    cover_state_t halted_state;
+    uint32_t halt_time;
+
+    // Last position passed to on_change, in percent
+    uint8_t reported;
+
+    cover_t *next;
+};
+
+/**
+    Starts cover task.
+
+    @return A negative integer if this method fails.
+*/
+int cover_init();
+
+/**
+    Adds cover to the task. Cover starts stopped at given position.
+
+    @param cover Cover state
+    @param config Cover configuration
+    @param position Initial position, in percent
+    @return A negative integer if this method fails.
+*/
+int cover_add(cover_t *cover, const cover_config_t *config, uint8_t position);
+
+/**
+    Moves cover to target position, in percent. Changing target
+    in the same direction continues current move.
+*/
+void cover_set_target(cover_t *cover, uint8_t target);
+
+/**
+    Stops cover at its current position.
+*/
+void cover_stop(cover_t *cover);
+
+/**
+    Returns current position, in percent.
+*/
+uint8_t cover_get_position(cover_t *cover);
+
+/**
+    Returns current target position, in percent.
+*/
+uint8_t cover_get_target(cover_t *cover);
+
+cover_state_t cover_get_state(cover_t *cover);
+
+/**
+    Updates moving covers, stops motors that are due.
+
+    @param now Current time in milliseconds
+    @return Time in milliseconds until next update or COVER_IDLE
+*/
+uint32_t cover_tick(uint32_t now);
+
+#ifdef COVER_HOST
+uint32_t cover_host_now();
+#endif
@@ -0,0 +1,8 @@
+# Component makefile for dimming
+# Gamma table is computed with powf(), so program should have LIBS += m
+
+INC_DIRS += $(dimming_ROOT)
+
+dimming_SRC_DIR = $(dimming_ROOT)
+
+$(eval $(call component_compile_rules,dimming))
@@ -0,0 +1,68 @@
+#include <math.h>
+
+#include "dimming.h"
+
+
+void dimming_init(dimming_t *dimming, const dimming_config_t *config) {
+    float gamma = (config->gamma > 0) ? config->gamma : 1.0;
+
+    dimming->min_on = config->min_on;
+    for (int i = 0; i <= 256; i++) {
+        dimming->table[i] = (uint16_t)(powf(i / 256.0f, gamma) * DIMMING_MAX + 0.5f);
+    }
+}
+
+
+uint16_t dimming_apply(const dimming_t *dimming, uint16_t level) {
+    if (!level)
+        return 0;
+
+    uint16_t lo = dimming->table[level >> 8];
+    uint16_t hi = dimming->table[(level >> 8) + 1];
+    uint16_t duty = lo + (((uint32_t)(hi - lo) * (level & 0xff)) >> 8);
+
+    // Last table entry is at 256, so make sure full level is full duty
+    if (level == DIMMING_MAX)
+        duty = DIMMING_MAX;
+
+    return (duty < dimming->min_on) ? dimming->min_on : duty;
+}
+
+
+uint8_t dimming_dither8(dimming_dither_t *dither, uint16_t duty) {
+    uint16_t value = duty >> 8;
+    uint16_t error = dither->error + (duty & 0xff);
+
+    if (error >= 0x100 && value < 0xff)
+        value++;
+
+    dither->error = error & 0xff;
+    return value;
+}
+
+
+uint8_t dimming_dither_bits(uint32_t frame_period) {
+    uint8_t bits = 0;
+    // Cycle of n fractional bits is 2^n frames long
+    while (bits < 8 && (frame_period << (bits + 1)) <= DIMMING_DITHER_MAX_CYCLE)
+        bits++;
+    return bits;
+}
+
+
+uint16_t dimming_round8(uint16_t duty, uint8_t dither_bits) {
+    if ((duty >> 8) >= DIMMING_DITHER8_THRESHOLD)
+        dither_bits = 0;
+    if (dither_bits >= 8)
+        return duty;
+
+    uint8_t shift = 8 - dither_bits;
+    uint32_t rounded = ((uint32_t)duty + (1 << (shift - 1))) >> shift << shift;
+    if (rounded > DIMMING_MAX)
+        rounded = DIMMING_MAX & ~((1 << shift) - 1);
+    else if (duty && !rounded)
+        // Light that is on stays on
+        rounded = 1 << shift;
+
+    return rounded;
+}
@@ -0,0 +1,96 @@
+/*
+ * Brightness pipeline for 16-bit light outputs.
+ *
+ * Maps linear brightness level to output duty through a gamma table
+ * (257 entries, interpolated), so low levels get fine steps. Non-zero
+ * levels are clamped to a minimum duty at which the light is still on.
+ *
+ * Temporal dithering spreads the fractional part of a 16-bit duty
+ * over consecutive frames of an 8-bit output (e.g. WS2812). It is only
+ * worth it at low levels, where one 8-bit step is a visible jump, and
+ * only if the whole dither cycle is short enough not to be seen as
+ * flicker. dimming_round8() keeps just as many fractional bits as
+ * the frame rate allows and rounds everything else to 8 bits, so
+ * output can stop rendering once the color is set.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define DIMMING_MAX UINT16_MAX
+
+// Duties are dithered only below this many 8-bit output steps
+#define DIMMING_DITHER8_THRESHOLD 16
+// Longest dither cycle that is not seen as flicker, in milliseconds
+#define DIMMING_DITHER_MAX_CYCLE 20
+
+typedef struct {
+    // Output = level ^ gamma, 1.0 for linear
+    float gamma;
+    // Minimum output duty for any non-zero level
+    uint16_t min_on;
+} dimming_config_t;
+
+typedef struct {
+    uint16_t min_on;
+    uint16_t table[257];
+} dimming_t;
+
+typedef struct {
+    uint8_t error;
+} dimming_dither_t;
+
+/**
+    Computes gamma table.
+*/
+void dimming_init(dimming_t *dimming, const dimming_config_t *config);
+
+/**
+    @param level Linear brightness level (0-DIMMING_MAX)
+    @return Output duty (0-DIMMING_MAX)
+*/
+uint16_t dimming_apply(const dimming_t *dimming, uint16_t level);
+
+/**
+    @param percent Brightness in percent (0-100)
+    @return Brightness level (0-DIMMING_MAX)
+*/
+static inline uint16_t dimming_level(uint8_t percent) {
+    if (percent >= 100)
+        return DIMMING_MAX;
+    return ((uint32_t)percent * DIMMING_MAX + 50) / 100;
+}
+
+/**
+    Reduces 16-bit duty to 8 bits for the next frame, carrying the
+    rounding error over to the following frames.
+
+    @param dither Dithering state, one per output channel
+    @param duty Output duty (0-DIMMING_MAX)
+    @return 8-bit output for this frame
+*/
+uint8_t dimming_dither8(dimming_dither_t *dither, uint16_t duty);
+
+/**
+    @param frame_period Time between dithered frames, in milliseconds
+    @return Number of fractional bits that can be dithered without visible
+            flicker, 0 if frame rate is too low for dithering
+*/
+uint8_t dimming_dither_bits(uint32_t frame_period);
+
+/**
+    Rounds duty for 8-bit output. Below DIMMING_DITHER8_THRESHOLD
+    dither_bits fractional bits are kept, above it duty is rounded to 8 bits.
+
+    @param duty Output duty (0-DIMMING_MAX)
+    @param dither_bits Result of dimming_dither_bits()
+    @return Rounded duty (0-DIMMING_MAX)
+*/
+uint16_t dimming_round8(uint16_t duty, uint8_t dither_bits);
+
+/**
+    @return Whether duty has a fractional part that needs dithering on 8-bit output
+*/
+static inline int dimming_needs_dither8(uint16_t duty) {
+    return (duty & 0xff) && (duty >> 8) < 0xff;
+}
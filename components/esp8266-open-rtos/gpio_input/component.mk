@@ -0,0 +1,7 @@
+# Component makefile for gpio_input
+
+INC_DIRS += $(gpio_input_ROOT)
+
+gpio_input_SRC_DIR = $(gpio_input_ROOT)
+
+$(eval $(call component_compile_rules,gpio_input))
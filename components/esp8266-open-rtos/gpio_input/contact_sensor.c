@@ -0,0 +1,138 @@
+/*
+ * Contact sensor with settle time debouncing.
+ *
+ * Every edge restarts settle timer, state is read once input has been
+ * quiet for settle_time. Settled state equal to the last reported one
+ * is dropped. With coalescing enabled, first change opens a window
+ * and only the state at the end of that window is reported.
+ */
+#include <string.h>
+#include "gpio_input.h"
+#include "contact_sensor.h"
+
+
+typedef struct {
+    contact_sensor_callback_fn callback;
+    contact_sensor_config_t config;
+
+    // Last reported state
+    contact_sensor_state_t state;
+    // Last settled state, not reported yet while coalescing
+    contact_sensor_state_t settled;
+
+    bool coalescing;
+    // time in microseconds
+    uint32_t coalesce_end;
+} contact_sensor_t;
+
+
+static contact_sensor_t sensors[GPIO_INPUT_MAX];
+
+static contact_sensor_stats_t stats;
+
+
+contact_sensor_state_t contact_sensor_state_get(uint8_t gpio_num) {
+    if (gpio_num < GPIO_INPUT_MAX && sensors[gpio_num].callback)
+        return sensors[gpio_num].state;
+
+    return gpio_read(gpio_num);
+}
+
+
+static void contact_sensor_report(uint8_t gpio_num, contact_sensor_t *sensor) {
+    sensor->coalescing = false;
+    if (sensor->settled == sensor->state)
+        return;
+
+    sensor->state = sensor->settled;
+    stats.changes++;
+    sensor->callback(gpio_num, sensor->state);
+}
+
+
+static void contact_sensor_coalesced(uint8_t gpio_num, uint32_t time, void *context) {
+    contact_sensor_report(gpio_num, context);
+}
+
+
+static void contact_sensor_settled(uint8_t gpio_num, uint32_t time, void *context) {
+    contact_sensor_t *sensor = context;
+
+    sensor->settled = gpio_read(gpio_num) ? CONTACT_OPEN : CONTACT_CLOSED;
+
+    if (!sensor->coalescing) {
+        if (sensor->settled == sensor->state)
+            return;
+
+        if (!sensor->config.coalesce_time) {
+            contact_sensor_report(gpio_num, sensor);
+            return;
+        }
+
+        sensor->coalescing = true;
+        sensor->coalesce_end = time + sensor->config.coalesce_time * 1000;
+    }
+
+    int32_t remaining = sensor->coalesce_end - time;
+    if (remaining <= 0) {
+        contact_sensor_report(gpio_num, sensor);
+        return;
+    }
+
+    gpio_input_timer_start(gpio_num, (remaining + 999) / 1000, contact_sensor_coalesced);
+}
+
+
+static void contact_sensor_handler(uint8_t gpio_num, bool level, uint32_t time, void *context) {
+    contact_sensor_t *sensor = context;
+
+    stats.edges++;
+
+    // Also suspends pending coalesce timer until input settles again
+    gpio_input_timer_start(gpio_num, sensor->config.settle_time, contact_sensor_settled);
+}
+
+
+int contact_sensor_create_ex(const uint8_t gpio_num, const contact_sensor_config_t *config,
+                             contact_sensor_callback_fn callback) {
+    if (gpio_num >= GPIO_INPUT_MAX || sensors[gpio_num].callback)
+        return -1;
+
+    contact_sensor_t *sensor = &sensors[gpio_num];
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->callback = callback;
+    sensor->config = *config;
+
+    gpio_enable(gpio_num, GPIO_INPUT);
+    gpio_set_pullup(gpio_num, true, true);
+
+    sensor->state = gpio_read(gpio_num) ? CONTACT_OPEN : CONTACT_CLOSED;
+    sensor->settled = sensor->state;
+
+    if (gpio_input_attach(gpio_num, GPIO_INTTYPE_EDGE_ANY, contact_sensor_handler, sensor)) {
+        sensor->callback = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int contact_sensor_create(const uint8_t gpio_num, contact_sensor_callback_fn callback) {
+    contact_sensor_config_t config = CONTACT_SENSOR_CONFIG();
+    return contact_sensor_create_ex(gpio_num, &config, callback);
+}
+
+
+void contact_sensor_delete(const uint8_t gpio_num) {
+    if (gpio_num >= GPIO_INPUT_MAX || !sensors[gpio_num].callback)
+        return;
+
+    gpio_input_detach(gpio_num);
+    sensors[gpio_num].callback = NULL;
+}
+
+
+void contact_sensor_get_stats(contact_sensor_stats_t *s) {
+    *s = stats;
+}
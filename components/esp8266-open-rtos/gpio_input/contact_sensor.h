@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+    CONTACT_CLOSED,
+    CONTACT_OPEN
+} contact_sensor_state_t;
+
+typedef void (*contact_sensor_callback_fn)(uint8_t gpio_num, contact_sensor_state_t event);
+
+typedef struct {
+    // Input has to stay unchanged for this time to be accepted, in milliseconds
+    uint16_t settle_time;
+    // Changes within this time after first one are merged and only the
+    // final state is reported at the end of it, in milliseconds, 0 to disable
+    uint16_t coalesce_time;
+} contact_sensor_config_t;
+
+#define CONTACT_SENSOR_CONFIG(...) \
+    (contact_sensor_config_t) { \
+        .settle_time = 50, \
+        .coalesce_time = 0, \
+        ##__VA_ARGS__ \
+    }
+
+typedef struct {
+    // Raw edges seen on contact sensor inputs
+    uint32_t edges;
+    // Number of times callbacks were called
+    uint32_t changes;
+} contact_sensor_stats_t;
+
+/**
+    Starts monitoring the given GPIO pin with default configuration.
+    Callback is only called when debounced state changes.
+
+    @param gpio_num The GPIO pin that should be monitored
+    @param callback The callback that is called when sensor state changes.
+    @return A negative integer if this method fails.
+*/
+int contact_sensor_create(uint8_t gpio_num, contact_sensor_callback_fn callback);
+
+/**
+    Starts monitoring the given GPIO pin with given configuration.
+
+    @param gpio_num The GPIO pin that should be monitored
+    @param config Sensor configuration, see CONTACT_SENSOR_CONFIG() for defaults
+    @param callback The callback that is called when sensor state changes.
+    @return A negative integer if this method fails.
+*/
+int contact_sensor_create_ex(uint8_t gpio_num, const contact_sensor_config_t *config,
+                             contact_sensor_callback_fn callback);
+
+void contact_sensor_delete(uint8_t gpio_num);
+
+/**
+    Returns last reported state of a monitored sensor, or current input
+    level for GPIOs that are not monitored.
+*/
+contact_sensor_state_t contact_sensor_state_get(uint8_t gpio_num);
+
+void contact_sensor_get_stats(contact_sensor_stats_t *stats);
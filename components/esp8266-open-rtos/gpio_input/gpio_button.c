@@ -0,0 +1,179 @@
+/*
+ * Button gesture detection.
+ *
+ * Debouncing accepts the first edge of a burst and ignores edges
+ * for debounce_time after it, so a burst has to be shorter than
+ * debounce_time. Timeouts (long press, hold repeat, waiting for
+ * next press) use the GPIO timer of gpio_input worker.
+ */
+#include <string.h>
+#include <espressif/esp_common.h>
+#include "gpio_input.h"
+#include "gpio_button.h"
+
+typedef enum {
+    gpio_button_state_idle,
+    gpio_button_state_pressed,
+    // Released, waiting for next press of a double/triple press
+    gpio_button_state_released,
+    // Held after long press
+    gpio_button_state_held,
+} gpio_button_state_t;
+
+typedef struct {
+    gpio_button_callback_fn callback;
+    gpio_button_config_t config;
+
+    gpio_button_state_t state;
+    bool level;
+    uint8_t press_count;
+
+    // time in microseconds
+    uint32_t last_event_time;
+} gpio_button_t;
+
+
+static gpio_button_t buttons[GPIO_INPUT_MAX];
+
+
+static void gpio_button_report_presses(uint8_t gpio_num, gpio_button_t *button) {
+    static const gpio_button_event_t events[] = {
+        gpio_button_event_single_press,
+        gpio_button_event_double_press,
+        gpio_button_event_triple_press,
+    };
+
+    uint8_t count = button->press_count;
+    button->press_count = 0;
+    button->state = gpio_button_state_idle;
+
+    if (count > 0 && count <= 3)
+        button->callback(gpio_num, events[count - 1]);
+}
+
+
+static void gpio_button_handler(uint8_t gpio_num, bool level, uint32_t time, void *context);
+
+static void gpio_button_timer(uint8_t gpio_num, uint32_t time, void *context) {
+    gpio_button_t *button = context;
+
+    switch (button->state) {
+        case gpio_button_state_pressed:
+            if (gpio_read(gpio_num) != button->config.pressed_value) {
+                // Release edge was lost in debounce time
+                button->last_event_time = time - button->config.debounce_time * 1000;
+                gpio_button_handler(gpio_num, !button->config.pressed_value, time, context);
+                break;
+            }
+            if (!button->config.long_press_time) {
+                // Only checking for lost release edge, see gpio_button_handler()
+                break;
+            }
+
+            button->state = gpio_button_state_held;
+            button->press_count = 0;
+            if (button->config.hold_repeat_time)
+                gpio_input_timer_start(gpio_num, button->config.hold_repeat_time, gpio_button_timer);
+            button->callback(gpio_num, gpio_button_event_long_press);
+            break;
+
+        case gpio_button_state_held:
+            gpio_input_timer_start(gpio_num, button->config.hold_repeat_time, gpio_button_timer);
+            button->callback(gpio_num, gpio_button_event_hold);
+            break;
+
+        case gpio_button_state_released:
+            gpio_button_report_presses(gpio_num, button);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void gpio_button_handler(uint8_t gpio_num, bool level, uint32_t time, void *context) {
+    gpio_button_t *button = context;
+
+    if (time - button->last_event_time < button->config.debounce_time * 1000) {
+        // debounce time, ignore events
+        return;
+    }
+    if (level == button->level) {
+        // state did not change
+        return;
+    }
+    button->last_event_time = time;
+    button->level = level;
+
+    if (level == button->config.pressed_value) {
+        if (button->state == gpio_button_state_idle)
+            button->press_count = 0;
+
+        button->press_count++;
+        button->state = gpio_button_state_pressed;
+
+        if (button->config.long_press_time) {
+            gpio_input_timer_start(gpio_num, button->config.long_press_time, gpio_button_timer);
+        } else if (button->config.debounce_time) {
+            // Release edge within debounce time is ignored, so level is checked
+            // again when it is over. Otherwise button would stay pressed.
+            gpio_input_timer_start(gpio_num, button->config.debounce_time, gpio_button_timer);
+        } else {
+            gpio_input_timer_stop(gpio_num);
+        }
+    } else if (button->state == gpio_button_state_held) {
+        gpio_input_timer_stop(gpio_num);
+        button->state = gpio_button_state_idle;
+    } else if (button->state == gpio_button_state_pressed) {
+        if (button->press_count >= button->config.max_repeat_presses) {
+            gpio_input_timer_stop(gpio_num);
+            gpio_button_report_presses(gpio_num, button);
+        } else {
+            button->state = gpio_button_state_released;
+            gpio_input_timer_start(gpio_num, button->config.repeat_press_timeout, gpio_button_timer);
+        }
+    }
+}
+
+
+int gpio_button_create_ex(const uint8_t gpio_num, const gpio_button_config_t *config, gpio_button_callback_fn callback) {
+    if (gpio_num >= GPIO_INPUT_MAX || buttons[gpio_num].callback)
+        return -1;
+
+    gpio_button_t *button = &buttons[gpio_num];
+    memset(button, 0, sizeof(*button));
+    button->callback = callback;
+    button->config = *config;
+    if (button->config.max_repeat_presses < 1)
+        button->config.max_repeat_presses = 1;
+    if (button->config.max_repeat_presses > 3)
+        button->config.max_repeat_presses = 3;
+
+    button->level = !config->pressed_value;
+    button->last_event_time = sdk_system_get_time();
+
+    gpio_enable(gpio_num, GPIO_INPUT);
+    gpio_set_pullup(gpio_num, true, true);
+    if (gpio_input_attach(gpio_num, GPIO_INTTYPE_EDGE_ANY, gpio_button_handler, button)) {
+        button->callback = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int gpio_button_create(const uint8_t gpio_num, bool pressed_value, uint16_t long_press_time, gpio_button_callback_fn callback) {
+    gpio_button_config_t config = GPIO_BUTTON_CONFIG(pressed_value, .long_press_time=long_press_time);
+    return gpio_button_create_ex(gpio_num, &config, callback);
+}
+
+
+void gpio_button_delete(const uint8_t gpio_num) {
+    if (gpio_num >= GPIO_INPUT_MAX || !buttons[gpio_num].callback)
+        return;
+
+    gpio_input_detach(gpio_num);
+    buttons[gpio_num].callback = NULL;
+}
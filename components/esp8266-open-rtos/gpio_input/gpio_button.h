@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    gpio_button_event_single_press,
+    // Button is held for long_press_time, reported while still pressed
+    gpio_button_event_long_press,
+    gpio_button_event_double_press,
+    gpio_button_event_triple_press,
+    // Button is still held after long press, repeated every hold_repeat_time
+    gpio_button_event_hold,
+} gpio_button_event_t;
+
+typedef void (*gpio_button_callback_fn)(uint8_t gpio_num, gpio_button_event_t event);
+
+typedef struct {
+    // GPIO value when the button is pressed
+    bool pressed_value;
+    // Edges within this time after previous one are ignored, in milliseconds
+    uint16_t debounce_time;
+    // Time to hold the button for a long press, in milliseconds, 0 to disable
+    uint16_t long_press_time;
+    // Time to wait for next press of double/triple press, in milliseconds
+    uint16_t repeat_press_timeout;
+    // Period of hold events after long press, in milliseconds, 0 to disable
+    uint16_t hold_repeat_time;
+    // Maximum number of presses in a row to detect (1-3). With 1, single
+    // press is reported right on release without waiting for more presses.
+    uint8_t max_repeat_presses;
+} gpio_button_config_t;
+
+#define GPIO_BUTTON_CONFIG(pressed, ...) \
+    (gpio_button_config_t) { \
+        .pressed_value = pressed, \
+        .debounce_time = 50, \
+        .long_press_time = 1000, \
+        .repeat_press_timeout = 300, \
+        .hold_repeat_time = 0, \
+        .max_repeat_presses = 1, \
+        ##__VA_ARGS__ \
+    }
+
+/** 
+    Starts monitoring the given GPIO pin for the pressed value. Events are recieved through the callback.
+    Only single press and long press events are reported.
+
+    @param gpio_num The GPIO pin that should be monitored
+    @param pressed_value The expected value when the button is pressed. For buttons connected to ground this is 0/false, for other buttons this might be 1/true.
+    @param long_press_time The duration that should be recognized as a long press, in miliseconds.
+    @param callback The callback that is called when an "button" event occurs.
+    @return A negative integer if this method fails.
+*/
+int gpio_button_create(uint8_t gpio_num, bool pressed_value, uint16_t long_press_time, gpio_button_callback_fn callback);
+
+/** 
+    Starts monitoring the given GPIO pin with given gesture configuration.
+
+    @param gpio_num The GPIO pin that should be monitored
+    @param config Button configuration, see GPIO_BUTTON_CONFIG() for defaults
+    @param callback The callback that is called when an "button" event occurs.
+    @return A negative integer if this method fails.
+*/
+int gpio_button_create_ex(uint8_t gpio_num, const gpio_button_config_t *config, gpio_button_callback_fn callback);
+
+/** 
+    Removes the given GPIO pin from monitoring.
+
+    @param gpio_num The GPIO pin that should be removed from monitoring
+*/
+void gpio_button_delete(uint8_t gpio_num);
@@ -0,0 +1,223 @@
+#include <string.h>
+#include <espressif/esp_common.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "gpio_input.h"
+
+// Should be a power of 2
+#define GPIO_INPUT_QUEUE_SIZE 32
+
+// GPIO16 has no interrupt, worker task samples it instead
+#define GPIO_INPUT_POLLED 16
+#define GPIO_INPUT_POLL_INTERVAL 50  // in milliseconds
+
+
+typedef struct {
+    uint32_t time;
+    uint8_t gpio_num;
+    bool level;
+} gpio_input_event_t;
+
+
+typedef struct {
+    gpio_input_handler_fn handler;
+    void *context;
+
+    gpio_input_timer_fn timer;
+    uint32_t deadline;
+
+    // Only used for polled GPIO
+    gpio_inttype_t type;
+    bool level;
+} gpio_input_slot_t;
+
+
+static gpio_input_slot_t slots[GPIO_INPUT_MAX];
+
+// Single producer (interrupt handler), single consumer (worker task)
+static gpio_input_event_t queue[GPIO_INPUT_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_tail = 0;
+
+static gpio_input_stats_t stats;
+
+static TaskHandle_t gpio_input_task_handle = NULL;
+
+
+static void IRAM gpio_input_intr_handler(uint8_t gpio_num) {
+    uint8_t head = queue_head;
+    uint8_t next = (head + 1) & (GPIO_INPUT_QUEUE_SIZE - 1);
+
+    stats.edges++;
+    if (next == queue_tail) {
+        stats.dropped++;
+        return;
+    }
+
+    queue[head].time = sdk_system_get_time();
+    queue[head].gpio_num = gpio_num;
+    queue[head].level = gpio_read(gpio_num);
+    queue_head = next;
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(gpio_input_task_handle, &woken);
+    portEND_SWITCHING_ISR(woken);
+}
+
+
+// Runs expired timers, returns number of ticks until next one
+static TickType_t gpio_input_run_timers() {
+    TickType_t wait = portMAX_DELAY;
+    uint32_t now = sdk_system_get_time();
+
+    for (uint8_t gpio_num = 0; gpio_num < GPIO_INPUT_MAX; gpio_num++) {
+        gpio_input_slot_t *slot = &slots[gpio_num];
+        if (!slot->timer)
+            continue;
+
+        int32_t remaining = slot->deadline - now;
+        if (remaining <= 0) {
+            gpio_input_timer_fn timer = slot->timer;
+            slot->timer = NULL;
+            stats.timers++;
+            timer(gpio_num, now, slot->context);
+            // Timer could have been restarted from callback
+            if (!slot->timer)
+                continue;
+            remaining = slot->deadline - now;
+        }
+
+        TickType_t ticks = (remaining + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+        if (ticks < 1)
+            ticks = 1;
+        if (ticks < wait)
+            wait = ticks;
+    }
+
+    return wait;
+}
+
+
+// Samples polled GPIO, returns number of ticks until next sample
+static TickType_t gpio_input_poll() {
+    gpio_input_slot_t *slot = &slots[GPIO_INPUT_POLLED];
+    if (!slot->handler)
+        return portMAX_DELAY;
+
+    bool level = gpio_read(GPIO_INPUT_POLLED);
+    if (level != slot->level) {
+        slot->level = level;
+
+        // ISR counts edges too, increment is not atomic
+        taskENTER_CRITICAL();
+        stats.edges++;
+        taskEXIT_CRITICAL();
+
+        bool report = (slot->type == GPIO_INTTYPE_EDGE_ANY) ||
+            (slot->type == GPIO_INTTYPE_EDGE_POS && level) ||
+            (slot->type == GPIO_INTTYPE_EDGE_NEG && !level);
+        if (report)
+            slot->handler(GPIO_INPUT_POLLED, level, sdk_system_get_time(), slot->context);
+    }
+
+    TickType_t ticks = GPIO_INPUT_POLL_INTERVAL / portTICK_PERIOD_MS;
+    return ticks ? ticks : 1;
+}
+
+
+static void gpio_input_task(void *_args) {
+    TickType_t wait = portMAX_DELAY;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, wait);
+        stats.wakeups++;
+
+        while (queue_tail != queue_head) {
+            gpio_input_event_t event = queue[queue_tail];
+            queue_tail = (queue_tail + 1) & (GPIO_INPUT_QUEUE_SIZE - 1);
+
+            gpio_input_slot_t *slot = &slots[event.gpio_num];
+            if (slot->handler)
+                slot->handler(event.gpio_num, event.level, event.time, slot->context);
+        }
+
+        wait = gpio_input_run_timers();
+
+        // Polling restarts whenever task wakes up, so it is sampled at least this often
+        TickType_t poll_wait = gpio_input_poll();
+        if (poll_wait < wait)
+            wait = poll_wait;
+    }
+}
+
+
+int gpio_input_init() {
+    if (gpio_input_task_handle)
+        return 0;
+
+    if (xTaskCreate(gpio_input_task, "GPIO input", 512, NULL, 2, &gpio_input_task_handle) != pdPASS) {
+        gpio_input_task_handle = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int gpio_input_attach(uint8_t gpio_num, gpio_inttype_t type,
+                      gpio_input_handler_fn handler, void *context) {
+    if (gpio_num >= GPIO_INPUT_MAX || slots[gpio_num].handler)
+        return -1;
+
+    if (gpio_input_init())
+        return -2;
+
+    slots[gpio_num].context = context;
+    slots[gpio_num].type = type;
+    slots[gpio_num].level = gpio_read(gpio_num);
+    slots[gpio_num].handler = handler;
+
+    if (gpio_num == GPIO_INPUT_POLLED) {
+        xTaskNotifyGive(gpio_input_task_handle);
+        return 0;
+    }
+
+    gpio_set_interrupt(gpio_num, type, gpio_input_intr_handler);
+
+    return 0;
+}
+
+
+void gpio_input_detach(uint8_t gpio_num) {
+    if (gpio_num >= GPIO_INPUT_MAX)
+        return;
+
+    if (gpio_num != GPIO_INPUT_POLLED)
+        gpio_set_interrupt(gpio_num, GPIO_INTTYPE_NONE, NULL);
+
+    slots[gpio_num].handler = NULL;
+    slots[gpio_num].timer = NULL;
+    slots[gpio_num].context = NULL;
+}
+
+
+void gpio_input_timer_start(uint8_t gpio_num, uint32_t delay, gpio_input_timer_fn callback) {
+    if (gpio_num >= GPIO_INPUT_MAX)
+        return;
+
+    slots[gpio_num].deadline = sdk_system_get_time() + delay * 1000;
+    slots[gpio_num].timer = callback;
+}
+
+
+void gpio_input_timer_stop(uint8_t gpio_num) {
+    if (gpio_num >= GPIO_INPUT_MAX)
+        return;
+
+    slots[gpio_num].timer = NULL;
+}
+
+
+void gpio_input_get_stats(gpio_input_stats_t *s) {
+    *s = stats;
+}
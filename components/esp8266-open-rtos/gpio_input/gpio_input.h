@@ -0,0 +1,88 @@
+/*
+ * Shared GPIO input dispatcher.
+ *
+ * Interrupt handler only records a timestamped edge into a ring buffer.
+ * A single worker task drains the buffer and calls handler registered
+ * for the GPIO, so input handlers never run in interrupt context.
+ * Handlers are kept in a static table indexed by GPIO number.
+ *
+ * Each GPIO also has one software timer, run by the same worker task,
+ * so drivers can implement timeouts without timers of their own.
+ *
+ * GPIO16 has no interrupt, so while it is attached the worker task
+ * samples it every 50ms and reports changes like edges.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp/gpio.h>
+
+#define GPIO_INPUT_MAX 17
+
+/**
+    Called from worker task for every recorded edge.
+
+    @param gpio_num GPIO that changed
+    @param level GPIO level sampled right after the edge
+    @param time Time of the edge, in microseconds
+    @param context Context passed to gpio_input_attach()
+*/
+typedef void (*gpio_input_handler_fn)(uint8_t gpio_num, bool level, uint32_t time, void *context);
+
+/**
+    Called from worker task when GPIO timer expires.
+
+    @param gpio_num GPIO the timer belongs to
+    @param time Current time, in microseconds
+    @param context Context passed to gpio_input_attach()
+*/
+typedef void (*gpio_input_timer_fn)(uint8_t gpio_num, uint32_t time, void *context);
+
+typedef struct {
+    uint32_t edges;
+    uint32_t dropped;
+    uint32_t wakeups;
+    uint32_t timers;
+} gpio_input_stats_t;
+
+/**
+    Starts worker task. Safe to call several times.
+
+    @return A negative integer if this method fails.
+*/
+int gpio_input_init();
+
+/**
+    Enables interrupt on GPIO and registers handler for it.
+
+    @param gpio_num GPIO to monitor
+    @param type Interrupt type, e.g. GPIO_INTTYPE_EDGE_ANY
+    @param handler Handler to call for every edge
+    @param context Value passed to handler
+    @return A negative integer if GPIO is invalid or already has a handler.
+*/
+int gpio_input_attach(uint8_t gpio_num, gpio_inttype_t type,
+                      gpio_input_handler_fn handler, void *context);
+
+/**
+    Disables interrupt on GPIO and removes its handler.
+*/
+void gpio_input_detach(uint8_t gpio_num);
+
+/**
+    (Re)starts GPIO timer. Should only be called from input handlers
+    or timer callbacks, which all run in worker task.
+
+    @param gpio_num GPIO the timer belongs to
+    @param delay Time until timer expires, in milliseconds
+    @param callback Callback to call when timer expires
+*/
+void gpio_input_timer_start(uint8_t gpio_num, uint32_t delay, gpio_input_timer_fn callback);
+
+/**
+    Stops GPIO timer. Same restrictions as gpio_input_timer_start().
+*/
+void gpio_input_timer_stop(uint8_t gpio_num);
+
+void gpio_input_get_stats(gpio_input_stats_t *stats);
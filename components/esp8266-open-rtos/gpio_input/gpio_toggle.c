@@ -0,0 +1,99 @@
+#include <string.h>
+#include "gpio_input.h"
+#include "gpio_toggle.h"
+
+#define LPF_SHIFT 3  // divide by 8
+#define LPF_INTERVAL 10  // in milliseconds
+
+#define maxvalue_unsigned(x) ((1<<(8*sizeof(x)))-1)
+
+typedef struct {
+    gpio_toggle_callback_fn callback;
+
+    uint8_t state;
+    uint16_t value;
+    bool sampling;
+} gpio_toggle_t;
+
+
+static gpio_toggle_t toggles[GPIO_INPUT_MAX];
+
+static gpio_toggle_stats_t stats;
+
+
+static void gpio_toggle_sample(uint8_t gpio_num, uint32_t time, void *context) {
+    gpio_toggle_t *toggle = context;
+
+    stats.samples++;
+
+    uint8_t level = gpio_read(gpio_num);
+    int16_t delta = ((level * maxvalue_unsigned(toggle->value)) - toggle->value) >> LPF_SHIFT;
+    toggle->value += delta;
+
+    uint8_t state = (toggle->value > (maxvalue_unsigned(toggle->value) / 2));
+    if (state != toggle->state) {
+        toggle->state = state;
+        stats.toggles++;
+        toggle->callback(gpio_num);
+    }
+
+    if (delta == 0 && level == toggle->state) {
+        // Filter has settled, nothing will change until next edge
+        toggle->sampling = false;
+        return;
+    }
+
+    gpio_input_timer_start(gpio_num, LPF_INTERVAL, gpio_toggle_sample);
+}
+
+
+static void gpio_toggle_handler(uint8_t gpio_num, bool level, uint32_t time, void *context) {
+    gpio_toggle_t *toggle = context;
+
+    stats.edges++;
+
+    // While sampling, bounces are taken care of by the filter
+    if (toggle->sampling)
+        return;
+
+    toggle->sampling = true;
+    gpio_input_timer_start(gpio_num, LPF_INTERVAL, gpio_toggle_sample);
+}
+
+
+int gpio_toggle_create(const uint8_t gpio_num, gpio_toggle_callback_fn callback) {
+    if (gpio_num >= GPIO_INPUT_MAX || toggles[gpio_num].callback)
+        return -1;
+
+    gpio_toggle_t *toggle = &toggles[gpio_num];
+    memset(toggle, 0, sizeof(*toggle));
+    toggle->callback = callback;
+
+    gpio_enable(gpio_num, GPIO_INPUT);
+    gpio_set_pullup(gpio_num, true, true);
+
+    // initial state is as initilised, filter starts settled at that state
+    toggle->state = gpio_read(gpio_num);
+    toggle->value = toggle->state ? maxvalue_unsigned(toggle->value) : 0;
+
+    if (gpio_input_attach(gpio_num, GPIO_INTTYPE_EDGE_ANY, gpio_toggle_handler, toggle)) {
+        toggle->callback = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void gpio_toggle_delete(const uint8_t gpio_num) {
+    if (gpio_num >= GPIO_INPUT_MAX || !toggles[gpio_num].callback)
+        return;
+
+    gpio_input_detach(gpio_num);
+    toggles[gpio_num].callback = NULL;
+}
+
+
+void gpio_toggle_get_stats(gpio_toggle_stats_t *s) {
+    *s = stats;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef void (*gpio_toggle_callback_fn)(uint8_t gpio_num);
+
+typedef struct {
+    // Edges recorded on toggle inputs
+    uint32_t edges;
+    // Filter samples taken while inputs were settling
+    uint32_t samples;
+    // Number of times callbacks were called
+    uint32_t toggles;
+} gpio_toggle_stats_t;
+
+/**
+    Starts monitoring the given GPIO pin for change of state. Events are recieved through the callback.
+
+    Input is only sampled after an edge: every 10ms a low-pass filter is
+    updated until input settles, then monitoring goes back to waiting
+    for next edge.
+
+    @param gpio_num The GPIO pin that should be monitored
+    @param callback The callback that is called when an "toggle" event occurs.
+    @return A negative integer if this method fails.
+*/
+int gpio_toggle_create(uint8_t gpio_num, gpio_toggle_callback_fn callback);
+
+/**
+    Removes the given GPIO pin from monitoring.
+
+    @param gpio_num The GPIO pin that should be removed from monitoring
+*/
+void gpio_toggle_delete(uint8_t gpio_num);
+
+void gpio_toggle_get_stats(gpio_toggle_stats_t *stats);
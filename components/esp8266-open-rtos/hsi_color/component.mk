@@ -0,0 +1,7 @@
+# Component makefile for hsi_color
+
+INC_DIRS += $(hsi_color_ROOT)
+
+hsi_color_SRC_DIR = $(hsi_color_ROOT)
+
+$(eval $(call component_compile_rules,hsi_color))
@@ -0,0 +1,135 @@
+#include "hsi_color.h"
+
+#define Q15_ONE (1 << 15)
+#define Q15_ONE_THIRD 10923
+
+// (1 + cos(h) / cos(60 - h)) / 3 for h = 0..119 degrees, Q15
+static const uint16_t hue_ratio[120] = {
+    32768, 32127, 31522, 30950, 30408, 29893, 29404, 28937,
+    28491, 28065, 27657, 27266, 26890, 26528, 26179, 25843,
+    25519, 25205, 24901, 24607, 24321, 24044, 23774, 23512,
+    23257, 23007, 22764, 22527, 22295, 22068, 21845, 21627,
+    21414, 21204, 20998, 20795, 20596, 20399, 20206, 20015,
+    19827, 19641, 19458, 19276, 19096, 18919, 18742, 18568,
+    18395, 18223, 18052, 17882, 17713, 17545, 17378, 17212,
+    17045, 16880, 16714, 16549, 16384, 16219, 16054, 15888,
+    15723, 15556, 15390, 15223, 15055, 14886, 14716, 14545,
+    14373, 14200, 14026, 13849, 13672, 13492, 13310, 13127,
+    12941, 12753, 12562, 12369, 12172, 11973, 11770, 11564,
+    11354, 11141, 10923, 10700, 10473, 10241, 10004,  9761,
+     9511,  9256,  8994,  8724,  8447,  8161,  7867,  7563,
+     7249,  6925,  6589,  6240,  5878,  5502,  5111,  4703,
+     4277,  3831,  3364,  2875,  2360,  1818,  1246,   641,
+};
+
+// (i / 100) ^ 1.5 for i = 0..100, Q15
+static const uint16_t intensity_shaped[101] = {
+        0,    33,    93,   170,   262,   366,   482,   607,   741,   885,
+     1036,  1195,  1362,  1536,  1716,  1904,  2097,  2297,  2502,  2714,
+     2931,  3153,  3381,  3614,  3853,  4096,  4344,  4597,  4855,  5117,
+     5384,  5656,  5932,  6212,  6496,  6785,  7078,  7375,  7676,  7981,
+     8290,  8603,  8919,  9240,  9564,  9892, 10223, 10558, 10897, 11239,
+    11585, 11935, 12287, 12643, 13003, 13366, 13732, 14101, 14474, 14850,
+    15229, 15612, 15997, 16386, 16777, 17172, 17570, 17971, 18374, 18781,
+    19191, 19604, 20019, 20438, 20859, 21283, 21711, 22140, 22573, 23009,
+    23447, 23888, 24332, 24778, 25227, 25679, 26134, 26591, 27050, 27513,
+    27978, 28445, 28916, 29388, 29864, 30341, 30822, 31305, 31790, 32278,
+    32768,
+};
+
+
+static inline uint32_t percent_to_q15(uint8_t percent) {
+    if (percent >= 100)
+        return Q15_ONE;
+
+    // percent * 32768 / 100 without a division
+    return ((uint32_t)percent * 83886 + 128) >> 8;
+}
+
+static inline uint32_t intensity_to_q15(const hsi_color_config_t *config, uint8_t intensity) {
+    if (intensity > 100)
+        intensity = 100;
+
+    if (config->intensity == hsi_color_intensity_shaped)
+        return intensity_shaped[intensity];
+
+    return percent_to_q15(intensity);
+}
+
+static inline uint16_t q15_to_depth(uint32_t value, uint8_t depth) {
+    return (value * ((1 << depth) - 1) + (1 << 14)) >> 15;
+}
+
+// Splits hue into 120 degree sector (0 - red, 1 - green, 2 - blue)
+// and Q15 ratio of primary color within that sector.
+static inline uint8_t hue_sector(uint16_t hue, uint32_t *ratio) {
+    hue %= 360;
+
+    uint8_t sector = 0;
+    if (hue >= 240) {
+        sector = 2;
+        hue -= 240;
+    } else if (hue >= 120) {
+        sector = 1;
+        hue -= 120;
+    }
+
+    *ratio = hue_ratio[hue];
+    return sector;
+}
+
+static inline void assign_channels(uint8_t sector, uint8_t depth,
+                                   uint32_t primary, uint32_t secondary, uint32_t tertiary,
+                                   hsi_color_t *color) {
+    uint16_t p = q15_to_depth(primary, depth);
+    uint16_t s = q15_to_depth(secondary, depth);
+    uint16_t t = q15_to_depth(tertiary, depth);
+
+    switch (sector) {
+        case 0:
+            color->red = p; color->green = s; color->blue = t;
+            break;
+        case 1:
+            color->green = p; color->blue = s; color->red = t;
+            break;
+        default:
+            color->blue = p; color->red = s; color->green = t;
+    }
+}
+
+void hsi2rgb(const hsi_color_config_t *config,
+             uint16_t hue, uint8_t saturation, uint8_t intensity,
+             hsi_color_t *color) {
+    uint32_t ratio;
+    uint8_t sector = hue_sector(hue, &ratio);
+
+    uint32_t s = percent_to_q15(saturation);
+    uint32_t i = intensity_to_q15(config, intensity);
+
+    uint32_t third = ((Q15_ONE - s) * Q15_ONE_THIRD) >> 15;
+    uint32_t primary = third + ((s * ratio) >> 15);
+    uint32_t secondary = third + ((s * (Q15_ONE - ratio)) >> 15);
+
+    assign_channels(sector, config->depth,
+                    (primary * i) >> 15, (secondary * i) >> 15, (third * i) >> 15,
+                    color);
+    color->white = 0;
+}
+
+void hsi2rgbw(const hsi_color_config_t *config,
+              uint16_t hue, uint8_t saturation, uint8_t intensity,
+              hsi_color_t *color) {
+    uint32_t ratio;
+    uint8_t sector = hue_sector(hue, &ratio);
+
+    uint32_t s = percent_to_q15(saturation);
+    uint32_t i = intensity_to_q15(config, intensity);
+
+    uint32_t primary = (s * ratio) >> 15;
+    uint32_t secondary = (s * (Q15_ONE - ratio)) >> 15;
+
+    assign_channels(sector, config->depth,
+                    (primary * i) >> 15, (secondary * i) >> 15, 0,
+                    color);
+    color->white = q15_to_depth(((Q15_ONE - s) * i) >> 15, config->depth);
+}
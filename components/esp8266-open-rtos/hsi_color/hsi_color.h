@@ -0,0 +1,57 @@
+/*
+ * Fixed-point HSI to RGB/RGBW color conversion shared by light examples.
+ *
+ * Based on http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
+ * but uses Q15 integer math and lookup tables instead of cos()/sqrt(),
+ * so it is cheap enough to run on every HomeKit write on an ESP8266.
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+    // Output is proportional to intensity
+    hsi_color_intensity_linear,
+    // Intensity is shaped as i^1.5 to have finer granularity near 0
+    hsi_color_intensity_shaped,
+} hsi_color_intensity_t;
+
+typedef struct {
+    // Bits per output channel: 8 for WS2812, 12 for MJPWM, 16 for multipwm
+    uint8_t depth;
+    hsi_color_intensity_t intensity;
+} hsi_color_config_t;
+
+typedef struct {
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+    uint16_t white;
+} hsi_color_t;
+
+/**
+    Converts HSI color to RGB. White channel is always set to 0.
+
+    @param config Output depth and intensity shaping
+    @param hue Hue in degrees, values above 359 wrap around
+    @param saturation Saturation in percent (0-100)
+    @param intensity Intensity in percent (0-100)
+    @param color Result, each channel is in range 0..(2^depth - 1)
+*/
+void hsi2rgb(const hsi_color_config_t *config,
+             uint16_t hue, uint8_t saturation, uint8_t intensity,
+             hsi_color_t *color);
+
+/**
+    Converts HSI color to RGBW, moving the unsaturated part of the color
+    to the white channel.
+
+    @param config Output depth and intensity shaping
+    @param hue Hue in degrees, values above 359 wrap around
+    @param saturation Saturation in percent (0-100)
+    @param intensity Intensity in percent (0-100)
+    @param color Result, each channel is in range 0..(2^depth - 1)
+*/
+void hsi2rgbw(const hsi_color_config_t *config,
+              uint16_t hue, uint8_t saturation, uint8_t intensity,
+              hsi_color_t *color);
@@ -0,0 +1,8 @@
+# Component makefile for led_frame
+# Requires extras/i2s_dma and extras/ws2812_i2s
+
+INC_DIRS += $(led_frame_ROOT)
+
+led_frame_SRC_DIR = $(led_frame_ROOT)
+
+$(eval $(call component_compile_rules,led_frame))
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include "led_frame.h"
+
+
+typedef struct {
+    uint16_t pixel_count;
+    pixel_type_t type;
+    TickType_t refresh_period;
+
+    // back buffer is drawn by callers, front buffer is owned by render task
+    ws2812_pixel_t *back;
+    ws2812_pixel_t *front;
+    bool dirty;
+
+    uint32_t transfer_count;
+
+    SemaphoreHandle_t lock;
+    TaskHandle_t task;
+} led_frame_t;
+
+
+static led_frame_t frame;
+
+
+static void led_frame_task(void *_args) {
+    TickType_t last_transfer = xTaskGetTickCount() - frame.refresh_period;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Let changes arriving within one refresh period coalesce
+        TickType_t elapsed = xTaskGetTickCount() - last_transfer;
+        if (elapsed < frame.refresh_period)
+            vTaskDelay(frame.refresh_period - elapsed);
+
+        xSemaphoreTake(frame.lock, portMAX_DELAY);
+        bool dirty = frame.dirty;
+        if (dirty) {
+            memcpy(frame.front, frame.back, frame.pixel_count * sizeof(ws2812_pixel_t));
+            frame.dirty = false;
+        }
+        xSemaphoreGive(frame.lock);
+
+        if (!dirty)
+            continue;
+
+        ws2812_i2s_update(frame.front, frame.type);
+        frame.transfer_count++;
+        last_transfer = xTaskGetTickCount();
+    }
+}
+
+
+int led_frame_init(uint16_t pixel_count, pixel_type_t type, uint16_t refresh_period) {
+    if (frame.task)
+        return -1;
+
+    frame.pixel_count = pixel_count;
+    frame.type = type;
+    frame.refresh_period = refresh_period / portTICK_PERIOD_MS;
+    if (!frame.refresh_period)
+        frame.refresh_period = 1;
+
+    frame.back = calloc(pixel_count, sizeof(ws2812_pixel_t));
+    frame.front = calloc(pixel_count, sizeof(ws2812_pixel_t));
+    frame.lock = xSemaphoreCreateMutex();
+    if (!frame.back || !frame.front || !frame.lock)
+        goto error;
+
+    ws2812_i2s_init(pixel_count, type);
+
+    // Start with all pixels off
+    frame.dirty = true;
+
+    if (xTaskCreate(led_frame_task, "LED frame", 256, NULL, 2, &frame.task) != pdPASS) {
+        frame.task = NULL;
+        goto error;
+    }
+    xTaskNotifyGive(frame.task);
+
+    return 0;
+
+error:
+    if (frame.lock)
+        vSemaphoreDelete(frame.lock);
+    free(frame.back);
+    free(frame.front);
+    memset(&frame, 0, sizeof(frame));
+    return -1;
+}
+
+
+ws2812_pixel_t *led_frame_lock() {
+    xSemaphoreTake(frame.lock, portMAX_DELAY);
+    return frame.back;
+}
+
+
+void led_frame_unlock(bool changed) {
+    if (changed)
+        frame.dirty = true;
+
+    xSemaphoreGive(frame.lock);
+
+    if (changed)
+        xTaskNotifyGive(frame.task);
+}
+
+
+void led_frame_set_pixel(uint16_t index, ws2812_pixel_t color) {
+    if (index >= frame.pixel_count)
+        return;
+
+    ws2812_pixel_t *pixels = led_frame_lock();
+    bool changed = (pixels[index].color != color.color);
+    pixels[index] = color;
+    led_frame_unlock(changed);
+}
+
+
+void led_frame_fill(ws2812_pixel_t color) {
+    ws2812_pixel_t *pixels = led_frame_lock();
+    bool changed = false;
+    for (int i = 0; i < frame.pixel_count; i++) {
+        if (pixels[i].color != color.color) {
+            pixels[i] = color;
+            changed = true;
+        }
+    }
+    led_frame_unlock(changed);
+}
+
+
+uint32_t led_frame_transfer_count() {
+    return frame.transfer_count;
+}
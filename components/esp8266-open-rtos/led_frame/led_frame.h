@@ -0,0 +1,54 @@
+/*
+ * Double-buffered frame buffer for ws2812_i2s LED strips.
+ *
+ * Drawing functions only update the back buffer and mark the frame dirty.
+ * A single render task copies the back buffer to the front buffer and
+ * pushes it to I2S at most once per refresh period, so several changes
+ * made in quick succession result in one DMA transfer, and changes
+ * that do not alter any pixel result in none.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+
+/**
+    Initializes ws2812_i2s driver, allocates frame buffers and starts render task.
+
+    @param pixel_count Number of pixels on the strip
+    @param type Pixel type of the strip (PIXEL_RGB or PIXEL_RGBW)
+    @param refresh_period Minimum time between two transfers, in milliseconds
+    @return A negative integer if this method fails.
+*/
+int led_frame_init(uint16_t pixel_count, pixel_type_t type, uint16_t refresh_period);
+
+/**
+    Sets color of a single pixel. Frame is marked dirty only if color has changed.
+*/
+void led_frame_set_pixel(uint16_t index, ws2812_pixel_t color);
+
+/**
+    Sets all pixels to given color. Frame is marked dirty only if any pixel has changed.
+*/
+void led_frame_fill(ws2812_pixel_t color);
+
+/**
+    Gives exclusive access to the back buffer for bulk drawing.
+    Must be followed by led_frame_unlock().
+
+    @return Pointer to back buffer pixels
+*/
+ws2812_pixel_t *led_frame_lock();
+
+/**
+    Releases back buffer acquired with led_frame_lock().
+
+    @param changed Whether pixels were modified and frame needs to be rendered
+*/
+void led_frame_unlock(bool changed);
+
+/**
+    @return Number of transfers pushed to the strip since initialization
+*/
+uint32_t led_frame_transfer_count();
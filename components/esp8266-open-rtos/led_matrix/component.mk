@@ -0,0 +1,7 @@
+# Component makefile for led_matrix
+
+INC_DIRS += $(led_matrix_ROOT)
+
+led_matrix_SRC_DIR = $(led_matrix_ROOT)
+
+$(eval $(call component_compile_rules,led_matrix))
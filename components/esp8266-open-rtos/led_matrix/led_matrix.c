@@ -0,0 +1,69 @@
+#include <stdlib.h>
+
+#include "led_matrix.h"
+
+
+static uint16_t led_matrix_compute_index(uint16_t width, uint16_t height, uint8_t layout,
+                                         uint16_t x, uint16_t y) {
+    uint16_t px, py, pw, ph;
+
+    switch (layout & LED_MATRIX_ROTATE_270) {
+        case LED_MATRIX_ROTATE_90:
+            pw = height; ph = width;
+            px = y; py = width - 1 - x;
+            break;
+        case LED_MATRIX_ROTATE_180:
+            pw = width; ph = height;
+            px = width - 1 - x; py = height - 1 - y;
+            break;
+        case LED_MATRIX_ROTATE_270:
+            pw = height; ph = width;
+            px = height - 1 - y; py = x;
+            break;
+        default:
+            pw = width; ph = height;
+            px = x; py = y;
+    }
+
+    if (layout & LED_MATRIX_FLIP_X)
+        px = pw - 1 - px;
+    if (layout & LED_MATRIX_FLIP_Y)
+        py = ph - 1 - py;
+
+    uint16_t major, minor, length;
+    if (layout & LED_MATRIX_COLUMNS) {
+        major = px; minor = py; length = ph;
+    } else {
+        major = py; minor = px; length = pw;
+    }
+
+    if ((layout & LED_MATRIX_SERPENTINE) && (major & 1))
+        minor = length - 1 - minor;
+
+    return major * length + minor;
+}
+
+
+led_matrix_t *led_matrix_new(uint16_t width, uint16_t height, uint8_t layout) {
+    led_matrix_t *matrix = malloc(sizeof(led_matrix_t) + width * height * sizeof(uint16_t));
+    if (!matrix)
+        return NULL;
+
+    matrix->width = width;
+    matrix->height = height;
+    matrix->layout = layout;
+
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++) {
+            matrix->index[y * width + x] =
+                led_matrix_compute_index(width, height, layout, x, y);
+        }
+    }
+
+    return matrix;
+}
+
+
+void led_matrix_free(led_matrix_t *matrix) {
+    free(matrix);
+}
@@ -0,0 +1,61 @@
+/*
+ * Mapping of 2D LED matrix coordinates to LED strip indexes.
+ *
+ * Animations draw in logical coordinates: x goes left to right,
+ * y goes bottom to top. Layout describes how the strip is wired:
+ *
+ *   LED_MATRIX_COLUMNS | LED_MATRIX_SERPENTINE, 3x4:
+ *
+ *     3   4  11
+ *     2   5  10
+ *     1   6   9
+ *     0   7   8
+ *
+ * Physical position of every logical pixel is computed once when
+ * matrix is created, so looking it up is a single table read.
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Strip runs along rows (default) or along columns
+#define LED_MATRIX_ROWS        0x00
+#define LED_MATRIX_COLUMNS     0x01
+// Every other row/column runs in opposite direction
+#define LED_MATRIX_SERPENTINE  0x02
+// First pixel is on the right instead of on the left
+#define LED_MATRIX_FLIP_X      0x04
+// First pixel is on the top instead of on the bottom
+#define LED_MATRIX_FLIP_Y      0x08
+// Logical picture is rotated clockwise on the physical matrix
+#define LED_MATRIX_ROTATE_0    0x00
+#define LED_MATRIX_ROTATE_90   0x10
+#define LED_MATRIX_ROTATE_180  0x20
+#define LED_MATRIX_ROTATE_270  0x30
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t layout;
+
+    uint16_t index[];
+} led_matrix_t;
+
+/**
+    Creates matrix mapping.
+
+    @param width Logical width
+    @param height Logical height
+    @param layout Combination of LED_MATRIX_* flags
+    @return Matrix mapping or NULL if there is not enough memory
+*/
+led_matrix_t *led_matrix_new(uint16_t width, uint16_t height, uint8_t layout);
+
+void led_matrix_free(led_matrix_t *matrix);
+
+/**
+    @return Strip index of pixel at given logical coordinates
+*/
+static inline uint16_t led_matrix_index(const led_matrix_t *matrix, uint16_t x, uint16_t y) {
+    return matrix->index[y * matrix->width + x];
+}
@@ -0,0 +1,7 @@
+# Component makefile for sensor_pipeline
+
+INC_DIRS += $(sensor_pipeline_ROOT)
+
+sensor_pipeline_SRC_DIR = $(sensor_pipeline_ROOT)
+
+$(eval $(call component_compile_rules,sensor_pipeline))
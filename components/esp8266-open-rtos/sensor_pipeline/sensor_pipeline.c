@@ -0,0 +1,138 @@
+#include <string.h>
+
+#include "sensor_pipeline.h"
+
+
+static float sensor_pipeline_median(sensor_pipeline_t *pipeline, uint8_t channel) {
+    float window[SENSOR_PIPELINE_MAX_SAMPLES];
+    uint8_t count = pipeline->sample_count;
+
+    // Insertion sort, window is tiny
+    for (int i = 0; i < count; i++) {
+        float value = pipeline->samples[i][channel];
+        int j = i;
+        for (; j > 0 && window[j-1] > value; j--)
+            window[j] = window[j-1];
+        window[j] = value;
+    }
+
+    if (count & 1)
+        return window[count / 2];
+
+    return (window[count / 2 - 1] + window[count / 2]) / 2;
+}
+
+
+static void sensor_pipeline_process(sensor_pipeline_t *pipeline, const float *raw) {
+    sensor_pipeline_config_t *config = &pipeline->config;
+
+    memcpy(pipeline->samples[pipeline->sample_head], raw, sizeof(float) * config->channels);
+    pipeline->sample_head = (pipeline->sample_head + 1) % config->median_size;
+    if (pipeline->sample_count < config->median_size)
+        pipeline->sample_count++;
+
+    bool stable = pipeline->has_value;
+    for (int i = 0; i < config->channels; i++) {
+        float value = sensor_pipeline_median(pipeline, i);
+        if (pipeline->has_value)
+            value = pipeline->values[i] + config->ema_alpha * (value - pipeline->values[i]);
+
+        float delta = value - pipeline->values[i];
+        if (delta > config->stable_delta[i] || -delta > config->stable_delta[i])
+            stable = false;
+
+        pipeline->values[i] = value;
+    }
+    pipeline->has_value = true;
+
+    if (stable) {
+        pipeline->interval *= 2;
+        if (pipeline->interval > config->slow_interval)
+            pipeline->interval = config->slow_interval;
+    } else {
+        pipeline->interval = config->fast_interval;
+    }
+}
+
+
+int sensor_pipeline_init(sensor_pipeline_t *pipeline, const sensor_pipeline_config_t *config) {
+    if (!config->read || !config->channels || config->channels > SENSOR_PIPELINE_MAX_CHANNELS)
+        return -1;
+    if (!config->median_size || config->median_size > SENSOR_PIPELINE_MAX_SAMPLES)
+        return -1;
+    if (!(config->ema_alpha > 0 && config->ema_alpha <= 1))
+        return -1;
+    if (!config->fast_interval || config->slow_interval < config->fast_interval)
+        return -1;
+
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->config = *config;
+    pipeline->interval = config->fast_interval;
+
+    return 0;
+}
+
+
+uint32_t sensor_pipeline_poll(sensor_pipeline_t *pipeline) {
+    sensor_pipeline_config_t *config = &pipeline->config;
+
+    float raw[SENSOR_PIPELINE_MAX_CHANNELS];
+    pipeline->stats.reads++;
+    if (!config->read(raw, config->context)) {
+        pipeline->stats.failures++;
+
+        uint32_t retry = config->retry_interval ? config->retry_interval : config->fast_interval;
+        for (int i = 0; i < pipeline->failures && retry < config->slow_interval; i++)
+            retry *= 2;
+        if (pipeline->failures < 32)
+            pipeline->failures++;
+
+        return retry < config->slow_interval ? retry : config->slow_interval;
+    }
+    pipeline->failures = 0;
+
+    sensor_pipeline_process(pipeline, raw);
+
+    if (config->on_value)
+        config->on_value(pipeline->values, config->context);
+
+    return pipeline->interval;
+}
+
+
+float sensor_pipeline_get_value(sensor_pipeline_t *pipeline, uint8_t channel) {
+    if (channel >= pipeline->config.channels)
+        return 0;
+
+    return pipeline->values[channel];
+}
+
+
+void sensor_pipeline_get_stats(sensor_pipeline_t *pipeline, sensor_pipeline_stats_t *stats) {
+    *stats = pipeline->stats;
+}
+
+
+#ifndef SENSOR_PIPELINE_HOST
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+static void sensor_pipeline_task(void *args) {
+    sensor_pipeline_t *pipeline = args;
+
+    while (true) {
+        uint32_t wait = sensor_pipeline_poll(pipeline);
+        vTaskDelay(wait / portTICK_PERIOD_MS);
+    }
+}
+
+
+int sensor_pipeline_start(sensor_pipeline_t *pipeline, const char *name) {
+    if (xTaskCreate(sensor_pipeline_task, name, 512, pipeline, 2, NULL) != pdPASS)
+        return -1;
+
+    return 0;
+}
+
+#endif
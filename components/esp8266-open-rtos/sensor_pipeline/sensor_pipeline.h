@@ -0,0 +1,112 @@
+/*
+ * Sensor sampling pipeline.
+ *
+ * Periodically calls a driver read function that returns one or more
+ * values (e.g. temperature and humidity), and passes them through:
+ *  - ring buffer of last raw samples and median of them, which rejects
+ *    single sample spikes;
+ *  - exponential moving average, which smooths remaining noise.
+ * Filtered values are handed to on_value callback.
+ *
+ * Poll interval adapts to the signal: it starts at fast_interval, doubles
+ * with every reading that stays within stable_delta of the previous one,
+ * up to slow_interval, and drops back to fast_interval on a change.
+ * Failed reads are retried after retry_interval, doubling with every
+ * consecutive failure up to slow_interval.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SENSOR_PIPELINE_MAX_CHANNELS 2
+#define SENSOR_PIPELINE_MAX_SAMPLES 7
+
+/**
+    Driver read function.
+
+    @param values Array of config.channels values to fill
+    @param context Driver context
+    @return true if reading was successful
+*/
+typedef bool (*sensor_pipeline_read_fn)(float *values, void *context);
+
+typedef struct {
+    sensor_pipeline_read_fn read;
+    // Number of values returned by read, up to SENSOR_PIPELINE_MAX_CHANNELS
+    uint8_t channels;
+
+    // Number of raw samples median is taken from, 1 disables median
+    uint8_t median_size;
+    // EMA weight of a new sample, 0 < alpha <= 1, 1 disables smoothing
+    float ema_alpha;
+
+    // Filtered value change per channel that is still considered stable
+    float stable_delta[SENSOR_PIPELINE_MAX_CHANNELS];
+
+    // times in milliseconds
+    uint32_t fast_interval;
+    uint32_t slow_interval;
+    uint32_t retry_interval;
+
+    // Called with filtered values after every successful read
+    void (*on_value)(const float *values, void *context);
+    // Passed to read and on_value
+    void *context;
+} sensor_pipeline_config_t;
+
+typedef struct {
+    uint32_t reads;
+    uint32_t failures;
+} sensor_pipeline_stats_t;
+
+typedef struct {
+    sensor_pipeline_config_t config;
+
+    // Ring buffer of raw samples
+    float samples[SENSOR_PIPELINE_MAX_SAMPLES][SENSOR_PIPELINE_MAX_CHANNELS];
+    uint8_t sample_head;
+    uint8_t sample_count;
+
+    bool has_value;
+    float values[SENSOR_PIPELINE_MAX_CHANNELS];
+
+    uint32_t interval;
+    uint8_t failures;
+
+    sensor_pipeline_stats_t stats;
+} sensor_pipeline_t;
+
+/**
+    Initializes pipeline state.
+
+    @param pipeline Pipeline state
+    @param config Pipeline configuration
+    @return 0 on success or a negative integer if configuration is invalid.
+*/
+int sensor_pipeline_init(sensor_pipeline_t *pipeline, const sensor_pipeline_config_t *config);
+
+/**
+    Reads sensor once and processes reading.
+
+    @param pipeline Pipeline state
+    @return Time until next read should happen, in milliseconds
+*/
+uint32_t sensor_pipeline_poll(sensor_pipeline_t *pipeline);
+
+/**
+    Starts a task that polls pipeline for as long as device runs.
+
+    @param pipeline Initialized pipeline
+    @param name Task name
+    @return 0 on success or a negative integer if this method fails.
+*/
+int sensor_pipeline_start(sensor_pipeline_t *pipeline, const char *name);
+
+/**
+    Returns last filtered value of a channel, or 0 if there was no
+    successful reading yet.
+*/
+float sensor_pipeline_get_value(sensor_pipeline_t *pipeline, uint8_t channel);
+
+void sensor_pipeline_get_stats(sensor_pipeline_t *pipeline, sensor_pipeline_stats_t *stats);
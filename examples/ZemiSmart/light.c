@@ -11,18 +11,20 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include <espressif/esp_wifi.h>
 #include <espressif/esp_sta.h>
 #include <esp/uart.h>
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
+#include <semphr.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
 
-#include <math.h>  //requires LIBS ?= hal m to be added to Makefile
+#include <hsi_color.h>
 #include "mjpwm.h"
 
 
@@ -37,67 +39,60 @@ static void wifi_init() {
     sdk_wifi_station_connect();
 }
 
-//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-void hsi2rgbw(float h, float s, float i, int* rgbw) {
-    int r, g, b, w;
-    float cos_h, cos_1047_h;
-    //h = fmod(h,360); // cycle h around to 0-360 degrees
-    h = 3.14159*h/(float)180; // Convert to radians.
-    s /=(float)100; i/=(float)100; //from percentage to ratio
-    s = s>0?(s<1?s:1):0; // clamp s and i to interval [0,1]
-    i = i>0?(i<1?i:1):0;
-    i = i*sqrt(i); //shape intensity to have finer granularity near 0
-
-    if(h < 2.09439) {
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        r = s*4095*i/3*(1+cos_h/cos_1047_h);
-        g = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
-        b = 0;
-        w = 4095*(1-s)*i;
-    } else if(h < 4.188787) {
-        h = h - 2.09439;
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        g = s*4095*i/3*(1+cos_h/cos_1047_h);
-        b = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
-        r = 0;
-        w = 4095*(1-s)*i;
-    } else {
-        h = h - 4.188787;
-        cos_h = cos(h);
-        cos_1047_h = cos(1.047196667-h);
-        b = s*4095*i/3*(1+cos_h/cos_1047_h);
-        r = s*4095*i/3*(1+(1-cos_h/cos_1047_h));
-        g = 0;
-        w = 4095*(1-s)*i;
-    }
-
-    rgbw[0]=r;
-    rgbw[1]=g;
-    rgbw[2]=b;
-    rgbw[3]=w;
-}
+const hsi_color_config_t light_color_config = {
+    .depth = 12,
+    .intensity = hsi_color_intensity_shaped,
+};
 
 #define PIN_DI 				13
 #define PIN_DCKI 			15
 
-float hue,sat,bri;
-bool on;
+void light_update(homekit_characteristic_t *ch, homekit_value_t value, void *context);
+
+// Characteristics hold the state, server reads them without calling getters
+homekit_characteristic_t on  = HOMEKIT_CHARACTERISTIC_(ON, true, .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_update));
+homekit_characteristic_t bri = HOMEKIT_CHARACTERISTIC_(BRIGHTNESS, 100, .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_update));
+homekit_characteristic_t hue = HOMEKIT_CHARACTERISTIC_(HUE, 0, .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_update));
+homekit_characteristic_t sat = HOMEKIT_CHARACTERISTIC_(SATURATION, 0, .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(light_update));
+
+// Last duty sent to the driver, writes that do not change it are not sent again
+hsi_color_t light_duty;
+bool light_duty_valid = false;
+
+// Serializes HomeKit writes and identify, so that light_duty always
+// matches what the driver was sent
+SemaphoreHandle_t light_lock;
+// Identify restores the state when it finishes
+bool light_identifying = false;
+
+static void light_set_locked(void) {
+    hsi_color_t rgbw = { 0, 0, 0, 0 };
+    if (on.value.bool_value) {
+        hsi2rgbw(&light_color_config,
+                 hue.value.float_value, sat.value.float_value, bri.value.int_value,
+                 &rgbw);
+    }
 
-void lightSET(void) {
-    int rgbw[4];
-    if (on) {
-        printf("h=%d,s=%d,b=%d => ",(int)hue,(int)sat,(int)bri);
-        
-        hsi2rgbw(hue,sat,bri,rgbw);
-        printf("r=%d,g=%d,b=%d,w=%d\n",rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
-        
-        mjpwm_send_duty(rgbw[0],rgbw[1],rgbw[2],rgbw[3]);
+    if (light_duty_valid && !memcmp(&rgbw, &light_duty, sizeof(rgbw)))
+        return;
+
+    if (on.value.bool_value) {
+        printf("h=%d,s=%d,b=%d => ",(int)hue.value.float_value,(int)sat.value.float_value,bri.value.int_value);
+        printf("r=%d,g=%d,b=%d,w=%d\n",rgbw.red,rgbw.green,rgbw.blue,rgbw.white);
     } else {
         printf("off\n");
-        mjpwm_send_duty(     0,      0,      0,      0 );
     }
+
+    mjpwm_send_duty(rgbw.red,rgbw.green,rgbw.blue,rgbw.white);
+    light_duty = rgbw;
+    light_duty_valid = true;
+}
+
+void lightSET(void) {
+    xSemaphoreTake(light_lock, portMAX_DELAY);
+    if (!light_identifying)
+        light_set_locked();
+    xSemaphoreGive(light_lock);
 }
 
 void light_init() {
@@ -109,77 +104,54 @@ void light_init() {
         .one_shot = MJPWM_CMD_ONE_SHOT_DISABLE,
         .resv = 0,
     };
+    light_lock = xSemaphoreCreateMutex();
     mjpwm_init(PIN_DI, PIN_DCKI, 1, init_cmd);
-    on=true; hue=0; sat=0; bri=100; //this should not be here, but part of the homekit init work
     lightSET();
 }
 
-homekit_value_t light_on_get() {
-    return HOMEKIT_BOOL(on);
-}
-void light_on_set(homekit_value_t value) {
-    if (value.format != homekit_format_bool) {
-        printf("Invalid on-value format: %d\n", value.format);
-        return;
-    }
-    on = value.bool_value;
+void light_update(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
     lightSET();
 }
 
-homekit_value_t light_bri_get() {
-    return HOMEKIT_INT(bri);
-}
-void light_bri_set(homekit_value_t value) {
-    if (value.format != homekit_format_int) {
-        printf("Invalid bri-value format: %d\n", value.format);
-        return;
-    }
-    bri = value.int_value;
-    lightSET();
-}
 
-homekit_value_t light_hue_get() {
-    return HOMEKIT_FLOAT(hue);
-}
-void light_hue_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        printf("Invalid hue-value format: %d\n", value.format);
-        return;
-    }
-    hue = value.float_value;
-    lightSET();
-}
-
-homekit_value_t light_sat_get() {
-    return HOMEKIT_FLOAT(sat);
-}
-void light_sat_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        printf("Invalid sat-value format: %d\n", value.format);
-        return;
-    }
-    sat = value.float_value;
-    lightSET();
+static void light_identify_send(uint16_t r, uint16_t g, uint16_t b, uint16_t w) {
+    xSemaphoreTake(light_lock, portMAX_DELAY);
+    mjpwm_send_duty(r, g, b, w);
+    xSemaphoreGive(light_lock);
 }
 
-
 void light_identify_task(void *_args) {
     for (int i=0;i<5;i++) {
-        mjpwm_send_duty(4095,    0,    0,    0);
+        light_identify_send(4095,    0,    0,    0);
         vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
-        mjpwm_send_duty(   0, 4095,    0,    0);
+        light_identify_send(   0, 4095,    0,    0);
         vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
-        mjpwm_send_duty(   0,    0, 4095,    0);
+        light_identify_send(   0,    0, 4095,    0);
         vTaskDelay(300 / portTICK_PERIOD_MS); //0.3 sec
     }
-    lightSET();
+
+    xSemaphoreTake(light_lock, portMAX_DELAY);
+    light_identifying = false;
+    light_duty_valid = false;
+    light_set_locked();
+    xSemaphoreGive(light_lock);
 
     vTaskDelete(NULL);
 }
 
 void light_identify(homekit_value_t _value) {
     printf("Light Identify\n");
-    xTaskCreate(light_identify_task, "Light identify", 256, NULL, 2, NULL);
+
+    xSemaphoreTake(light_lock, portMAX_DELAY);
+    bool running = light_identifying;
+    light_identifying = true;
+    xSemaphoreGive(light_lock);
+
+    if (!running && xTaskCreate(light_identify_task, "Light identify", 256, NULL, 2, NULL) != pdPASS) {
+        xSemaphoreTake(light_lock, portMAX_DELAY);
+        light_identifying = false;
+        xSemaphoreGive(light_lock);
+    }
 }
 
 
@@ -200,26 +172,10 @@ homekit_accessory_t *accessories[] = {
                 }),
             HOMEKIT_SERVICE(LIGHTBULB, .primary=true,
                 .characteristics=(homekit_characteristic_t*[]){
-                    HOMEKIT_CHARACTERISTIC(
-                        ON, true,
-                        .getter=light_on_get,
-                        .setter=light_on_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        BRIGHTNESS, 100,
-                        .getter=light_bri_get,
-                        .setter=light_bri_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        HUE, 0,
-                        .getter=light_hue_get,
-                        .setter=light_hue_set
-                    ),
-                    HOMEKIT_CHARACTERISTIC(
-                        SATURATION, 0,
-                        .getter=light_sat_get,
-                        .setter=light_sat_set
-                    ),
+                    &on,
+                    &bri,
+                    &hue,
+                    &sat,
                     NULL
                 }),
             NULL
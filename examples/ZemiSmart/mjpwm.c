@@ -11,7 +11,9 @@
  *     2017/12/24, adapted for esp-open-rtos
 *******************************************************************************/
 #include "mjpwm.h"
+#include <string.h>
 #include <espressif/esp_misc.h>  //defines sdk_os_delay_us
+#include <espressif/esp_common.h>
 #include <task.h>
 #include <esp/gpio.h>
 
@@ -36,105 +38,175 @@
 #define MJPWM_DIRECT_WRITE_HIGH(pin)    gpio_write(pin,1)
 
 
+#define MJPWM_MAX_CHIPS 8
+// 4 channels of up to 16 bits per chip
+#define MJPWM_STREAM_WORDS (MJPWM_MAX_CHIPS * 4 * 16 / 32)
+
 static int nc = 2;
 
 static uint8_t pin_di = 13;
 static uint8_t pin_dcki = 15;
+static uint32_t mask_di = (1 << 13);
+static uint32_t mask_dcki = (1 << 15);
 
 static mjpwm_cmd_t mjpwm_commands[GPIO_MAX_INDEX + 1];
 
-IRAM void mjpwm_di_pulse(uint16_t times)
+static mjpwm_stats_t mjpwm_stats;
+
+// Bits to send, most significant bit first, packed 32 per word.
+// Encoded before entering critical section, so that only
+// clocking data out is done with interrupts disabled.
+typedef struct {
+    uint16_t bit_count;
+    uint32_t words[MJPWM_STREAM_WORDS];
+} mjpwm_stream_t;
+
+static void mjpwm_stream_append(mjpwm_stream_t *stream, uint16_t data, uint8_t bit_length)
+{
+    for (int8_t i = bit_length - 1; i >= 0; i--) {
+        if (data & (1 << i))
+            stream->words[stream->bit_count >> 5] |= 0x80000000 >> (stream->bit_count & 31);
+        stream->bit_count++;
+    }
+}
+
+static inline bool mjpwm_stream_bit(const mjpwm_stream_t *stream, uint16_t index)
+{
+    return stream->words[index >> 5] & (0x80000000 >> (index & 31));
+}
+
+// Clock out stream, two bits per DCKI pulse: DI is sampled
+// on both rising and falling edge of DCKI.
+static IRAM void mjpwm_stream_send(const mjpwm_stream_t *stream)
+{
+    for (uint16_t i = 0; i < stream->bit_count; i += 2) {
+        // DCK = 0;
+        GPIO.OUT_CLEAR = mask_dcki;
+        if (mjpwm_stream_bit(stream, i))
+            GPIO.OUT_SET = mask_di;
+        else
+            GPIO.OUT_CLEAR = mask_di;
+
+        // DCK = 1;
+        GPIO.OUT_SET = mask_dcki;
+        if (mjpwm_stream_bit(stream, i + 1))
+            GPIO.OUT_SET = mask_di;
+        else
+            GPIO.OUT_CLEAR = mask_di;
+
+        // DCK = 0;
+        GPIO.OUT_CLEAR = mask_dcki;
+        // DI = 0;
+        GPIO.OUT_CLEAR = mask_di;
+    }
+}
+
+static IRAM void mjpwm_di_pulse_locked(uint16_t times)
 {
     uint16_t i;
     for (i = 0; i < times; i++) {
-        MJPWM_DIRECT_WRITE_HIGH(pin_di);
+        GPIO.OUT_SET = mask_di;
         asm("nop;");    // delay 50ns
-        MJPWM_DIRECT_WRITE_LOW(pin_di);
+        GPIO.OUT_CLEAR = mask_di;
         asm("nop;nop;nop;nop;nop;");
         // delay 230ns
     }
 }
 
+// Critical section time is measured per frame
+static uint32_t mjpwm_frame_time;
+
+static inline uint32_t mjpwm_critical_enter()
+{
+    taskENTER_CRITICAL(); //ets_intr_lock();
+    return sdk_system_get_time();
+}
+
+static inline void mjpwm_critical_exit(uint32_t start)
+{
+    mjpwm_frame_time += sdk_system_get_time() - start;
+    taskEXIT_CRITICAL(); //ets_intr_unlock();
+}
+
+static void mjpwm_frame_done()
+{
+    mjpwm_stats.frames++;
+    mjpwm_stats.critical_time_last = mjpwm_frame_time;
+    if (mjpwm_frame_time > mjpwm_stats.critical_time_max)
+        mjpwm_stats.critical_time_max = mjpwm_frame_time;
+    mjpwm_frame_time = 0;
+}
+
+// Timings between pulse bursts are minimums, so delays are done
+// with interrupts enabled, only bursts themselves are atomic.
+static void mjpwm_di_pulse_atomic(uint16_t times)
+{
+    uint32_t start = mjpwm_critical_enter();
+    mjpwm_di_pulse_locked(times);
+    mjpwm_critical_exit(start);
+}
+
+static void mjpwm_stream_send_atomic(const mjpwm_stream_t *stream)
+{
+    uint32_t start = mjpwm_critical_enter();
+    mjpwm_stream_send(stream);
+    mjpwm_critical_exit(start);
+}
+
+void mjpwm_di_pulse(uint16_t times)
+{
+    mjpwm_di_pulse_atomic(times);
+}
+
 void mjpwm_dcki_pulse(uint16_t times)
 {
     uint16_t i;
     for (i = 0; i < times; i++) {
-        MJPWM_DIRECT_WRITE_HIGH(pin_dcki);
+        GPIO.OUT_SET = mask_dcki;
         asm("nop;");        // delay 50ns
-        MJPWM_DIRECT_WRITE_LOW(pin_dcki);
+        GPIO.OUT_CLEAR = mask_dcki;
         asm("nop;");        // delay 50ns
     }
 }
 
 void mjpwm_send_command(mjpwm_cmd_t command)
 {
-    uint8_t i, n;
-    uint8_t command_data;
+    uint8_t n;
+    mjpwm_stream_t stream;
     mjpwm_commands[pin_dcki] = command;
 
-    taskENTER_CRITICAL(); //ets_intr_lock();
+    memset(&stream, 0, sizeof(stream));
+    for (n = 0; n < nc; n++) {
+        mjpwm_stream_append(&stream, *(uint8_t *) (&command), 8);
+    }
+
     // TStop > 12us.
     sdk_os_delay_us(12);
     // Send 12 DI pulse, after 6 pulse's falling edge store duty data, and 12
     // pulse's rising edge convert to command mode.
-    mjpwm_di_pulse(12);
+    mjpwm_di_pulse_atomic(12);
     // Delay >12us, begin send CMD data
     sdk_os_delay_us(12);
-    asm("nop;nop;");
     // Send CMD data
-
-    for (n = 0; n < nc; n++) {
-
-        command_data = *(uint8_t *) (&command);
-
-        for (i = 0; i < 4; i++) {
-            // DCK = 0;
-            MJPWM_DIRECT_WRITE_LOW(pin_dcki);
-            if (command_data & 0x80) {
-                // DI = 1;
-                MJPWM_DIRECT_WRITE_HIGH(pin_di);
-            } else {
-                // DI = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_di);
-            }
-            // DCK = 1;
-            MJPWM_DIRECT_WRITE_HIGH(pin_dcki);
-            command_data = command_data << 1;
-            if (command_data & 0x80) {
-                // DI = 1;
-                MJPWM_DIRECT_WRITE_HIGH(pin_di);
-            } else {
-                // DI = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_di);
-            }
-            // DCK = 0;
-            MJPWM_DIRECT_WRITE_LOW(pin_dcki);
-            // DI = 0;
-            MJPWM_DIRECT_WRITE_LOW(pin_di);
-            command_data = command_data << 1;
-        }
-
-        asm("nop;nop;nop;");
-    }
-
+    mjpwm_stream_send_atomic(&stream);
     // TStart > 12us. Delay 12 us.
     sdk_os_delay_us(12);
     // Send 16 DI pulse，at 14 pulse's falling edge store CMD data, and
     // at 16 pulse's falling edge convert to duty mode.
-    mjpwm_di_pulse(16);
+    mjpwm_di_pulse_atomic(16);
     // TStop > 12us.
     sdk_os_delay_us(12);
-    asm("nop;nop;");
-    taskEXIT_CRITICAL(); //ets_intr_unlock();
+
+    mjpwm_frame_done();
 }
 
-IRAM void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g,
+void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g,
         uint16_t duty_b, uint16_t duty_w)
 {
-    uint8_t i = 0, n;
+    uint8_t n;
     uint8_t channel = 0;
     uint8_t bit_length = 8;
-    uint16_t duty_current = 0;
+    mjpwm_stream_t stream;
 
     // Definition for RGBW channels
     uint16_t duty[4] = { duty_r, duty_g, duty_b, duty_w };
@@ -157,65 +229,38 @@ IRAM void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g,
         break;
     }
 
-    taskENTER_CRITICAL(); //ets_intr_lock();
-    // TStop > 12us.
-    sdk_os_delay_us(12);
-    asm("nop;nop;");
-
-    for (n = 0; n < nc; n++)
-    {
-        for (channel = 0; channel < 4; channel++)   //RGBW 4CH
-        {
-            // RGBW Channel
-            duty_current = duty[channel];
-            // Send 8bit/12bit/14bit/16bit Data
-            for (i = 0; i < bit_length / 2; i++) {
-
-                // DCK = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_dcki);
-                if (duty_current & (0x01 << (bit_length - 1))) {
-                    // DI = 1;
-                    MJPWM_DIRECT_WRITE_HIGH(pin_di);
-                } else {
-                    // DI = 0;
-                    MJPWM_DIRECT_WRITE_LOW(pin_di);
-                }
-
-                // DCK = 1;
-                MJPWM_DIRECT_WRITE_HIGH(pin_dcki);
-                duty_current = duty_current << 1;
-                if (duty_current & (0x01 << (bit_length - 1))) {
-                    // DI = 1;
-                    MJPWM_DIRECT_WRITE_HIGH(pin_di);
-                } else {
-                    // DI = 0;
-                    MJPWM_DIRECT_WRITE_LOW(pin_di);
-                }
-
-                //DCK = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_dcki);
-                //DI = 0;
-                MJPWM_DIRECT_WRITE_LOW(pin_di);
-
-                duty_current = duty_current << 1;
-            }
+    // Encode frame for all chips in the chain
+    memset(&stream, 0, sizeof(stream));
+    for (n = 0; n < nc; n++) {
+        for (channel = 0; channel < 4; channel++) {  //RGBW 4CH
+            mjpwm_stream_append(&stream, duty[channel], bit_length);
         }
     }
 
+    // TStop > 12us.
+    sdk_os_delay_us(12);
+    mjpwm_stream_send_atomic(&stream);
     // TStart > 12us. Ready for send DI pulse.
     sdk_os_delay_us(12);
     // Send 8 DI pulse. After 8 pulse falling edge, store old data.
-    mjpwm_di_pulse(8);
+    mjpwm_di_pulse_atomic(8);
     // TStop > 12us.
     sdk_os_delay_us(12);
-    asm("nop;nop;");
-    taskEXIT_CRITICAL(); //ets_intr_unlock();
+
+    mjpwm_frame_done();
+}
+
+void mjpwm_get_stats(mjpwm_stats_t *stats)
+{
+    *stats = mjpwm_stats;
 }
 
 void mjpwm_init(uint8_t di, uint8_t dcki, uint8_t n_chips, mjpwm_cmd_t cmd)
 {
     pin_di = di;
     pin_dcki = dcki;
+    mask_di = 1 << di;
+    mask_dcki = 1 << dcki;
 
     MJPWM_DIRECT_GPIO(pin_di);
     MJPWM_DIRECT_GPIO(pin_dcki);
@@ -224,7 +269,7 @@ void mjpwm_init(uint8_t di, uint8_t dcki, uint8_t n_chips, mjpwm_cmd_t cmd)
     MJPWM_DIRECT_WRITE_LOW(pin_di);
     MJPWM_DIRECT_WRITE_LOW(pin_dcki);
 
-    nc = n_chips;
+    nc = (n_chips > MJPWM_MAX_CHIPS) ? MJPWM_MAX_CHIPS : n_chips;
 
     // Clear all duty register
     mjpwm_dcki_pulse(32 * nc);
@@ -64,10 +64,19 @@ typedef struct mjpwm_cmd_t {
     .resv = 0, \
 }
 
+typedef struct mjpwm_stats_t {
+    uint32_t frames;
+    // Time spent with interrupts disabled, in microseconds
+    uint32_t critical_time_last;
+    uint32_t critical_time_max;
+} mjpwm_stats_t;
+
+// Pins should be in GPIO0-GPIO15 range, up to 8 chained chips are supported
 void mjpwm_init(uint8_t pin_di, uint8_t pin_dcki, uint8_t n_chips, mjpwm_cmd_t command);
 void mjpwm_di_pulse(uint16_t times);
 void mjpwm_dcki_pulse(uint16_t times);
 void mjpwm_send_command(mjpwm_cmd_t command);
 void mjpwm_send_duty(uint16_t duty_r, uint16_t duty_g, uint16_t duty_b, uint16_t duty_w);
+void mjpwm_get_stats(mjpwm_stats_t *stats);
 
 #endif /* __MJPWM_H__ */
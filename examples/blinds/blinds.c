@@ -16,14 +16,18 @@ Motorized blinds.  Crude approach simply constant time to open or close a blind.
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <characteristic_notify.h>
+#include <cover.h>
+#include <gpio_input.h>
 #include "wifi.h"
 
-#define POSITION_STATIONARY 0
-#define POSITION_JAMMED 1
-#define POSITION_OSCILLATING 2
+// Position updates while moving are sent at most once per interval, final position is flushed
+#define POSITION_NOTIFY_INTERVAL 1000
 
+characteristic_notify_t current_position_left_notify;
+characteristic_notify_t current_position_right_notify;
 
-int right_timer = 0, left_timer = 0;	// blind rotation timers
+cover_t left_blind, right_blind;
 
 
 homekit_value_t current_position_L_get();
@@ -57,7 +61,7 @@ homekit_characteristic_t target_position_left = HOMEKIT_CHARACTERISTIC_(
 	.callback=HOMEKIT_CHARACTERISTIC_CALLBACK(on_update_left)
 );
 homekit_characteristic_t position_state_left = HOMEKIT_CHARACTERISTIC_(
-        POSITION_STATE, POSITION_STATIONARY,
+        POSITION_STATE, cover_state_stopped,
         .getter=position_state_L_get,
         .setter=position_state_L_set
 );
@@ -73,7 +77,7 @@ homekit_characteristic_t target_position_right = HOMEKIT_CHARACTERISTIC_(
 	.callback=HOMEKIT_CHARACTERISTIC_CALLBACK(on_update_right)
 );
 homekit_characteristic_t position_state_right = HOMEKIT_CHARACTERISTIC_(
-        POSITION_STATE, POSITION_STATIONARY,
+        POSITION_STATE, cover_state_stopped,
         .getter=position_state_R_get,
         .setter=position_state_R_set
 );
@@ -103,17 +107,13 @@ const int remote_left_open = 5;
 const int remote_right_close = 16;
 const int remote_right_open = 10;
 
-const int poll_time = 50 / portTICK_PERIOD_MS;
-const int blind_one_pct_time = (6400 / portTICK_PERIOD_MS) / 100; // total time divided by 100 - used for manual control 
-const int left_blind_open_time = 4300 / portTICK_PERIOD_MS;
-const int left_blind_close_time = 5900 / portTICK_PERIOD_MS;	// bias due to heavier motor load 
-const int right_blind_open_time = 6000 / portTICK_PERIOD_MS;
-const int right_blind_close_time = 7000 / portTICK_PERIOD_MS;	// bias due to heavier motor load closing
-
-#define TIMER_TO_PCT_L_OPEN(x) ((x) * 100 / left_blind_open_time)
-#define TIMER_TO_PCT_L_CLOSE(x) ((x) * 100 / left_blind_close_time)
-#define TIMER_TO_PCT_R_OPEN(x) ((x) * 100 / right_blind_open_time)
-#define TIMER_TO_PCT_R_CLOSE(x) ((x) * 100 / right_blind_close_time)
+// Travel times in milliseconds, closing is biased due to heavier motor load
+#define LEFT_BLIND_OPEN_TIME 4300
+#define LEFT_BLIND_CLOSE_TIME 5900
+#define RIGHT_BLIND_OPEN_TIME 6000
+#define RIGHT_BLIND_CLOSE_TIME 7000
+// Motor run time past the end position, resets position estimate
+#define BLIND_END_STOP_TIME 500
 
 bool led_on = false;
 
@@ -127,230 +127,147 @@ void led_init() {
     led_write(led_on);
 }
 
-void main_task(void *_args) 
+void blind_motor(cover_t *cover, cover_state_t state)
+{
+	int open_gpio = (cover == &left_blind) ? left_blind_open : right_blind_open;
+	int close_gpio = (cover == &left_blind) ? left_blind_close : right_blind_close;
+
+	gpio_write(open_gpio, state == cover_state_opening);
+	gpio_write(close_gpio, state == cover_state_closing);
+	led_write(state != cover_state_stopped);
+}
+
+void blind_changed(cover_t *cover)
+{
+	bool left = (cover == &left_blind);
+	homekit_characteristic_t *current_position = left ? &current_position_left : &current_position_right;
+	homekit_characteristic_t *target_position = left ? &target_position_left : &target_position_right;
+	homekit_characteristic_t *position_state = left ? &position_state_left : &position_state_right;
+	characteristic_notify_t *current_position_notify = left ? &current_position_left_notify : &current_position_right_notify;
+
+	current_position->value.int_value = cover_get_position(cover);
+	characteristic_notify(current_position_notify, current_position->value);
+
+	if( position_state->value.int_value != cover_get_state(cover) )
+	{
+		position_state->value.int_value = cover_get_state(cover);
+		homekit_characteristic_notify(position_state, position_state->value);
+	}
+
+	if( cover_get_state(cover) == cover_state_stopped )
+	{
+		characteristic_notify_flush(current_position_notify);
+		// Target is where the blind actually stopped, e.g. after remote stepping
+		if( target_position->value.int_value != current_position->value.int_value )
+		{
+			target_position->value.int_value = current_position->value.int_value;
+			homekit_characteristic_notify(target_position, target_position->value);
+		}
+	}
+
+	printf("%c current: %d target: %d state %d\n", left ? 'L' : 'R',
+		current_position->value.int_value, cover_get_target(cover), cover_get_state(cover));
+}
+
+void blinds_init()
 {
 	gpio_enable(left_blind_close, GPIO_OUTPUT);
 	gpio_enable(left_blind_open, GPIO_OUTPUT);
 	gpio_enable(right_blind_close, GPIO_OUTPUT);
 	gpio_enable(right_blind_open, GPIO_OUTPUT);
-	
-//	gpio_enable(remote_valid, GPIO_INPUT);
-	gpio_enable(remote_left_close, GPIO_INPUT);
-	gpio_enable(remote_left_open, GPIO_INPUT);
-	gpio_enable(remote_right_close, GPIO_INPUT);
-	gpio_enable(remote_right_open, GPIO_INPUT);
-	
-	
-	while(1) 
+
+	characteristic_notify_config_t position_notify_config = {
+		.min_interval = POSITION_NOTIFY_INTERVAL,
+	};
+	characteristic_notify_init(&current_position_left_notify, &current_position_left, &position_notify_config);
+	characteristic_notify_init(&current_position_right_notify, &current_position_right, &position_notify_config);
+
+	cover_config_t left_config = {
+		.open_time = LEFT_BLIND_OPEN_TIME,
+		.close_time = LEFT_BLIND_CLOSE_TIME,
+		.end_stop_time = BLIND_END_STOP_TIME,
+		.motor = blind_motor,
+		.on_change = blind_changed,
+	};
+	cover_config_t right_config = {
+		.open_time = RIGHT_BLIND_OPEN_TIME,
+		.close_time = RIGHT_BLIND_CLOSE_TIME,
+		.end_stop_time = BLIND_END_STOP_TIME,
+		.motor = blind_motor,
+		.on_change = blind_changed,
+	};
+	if( cover_add(&left_blind, &left_config, current_position_left.value.int_value) ||
+	    cover_add(&right_blind, &right_config, current_position_right.value.int_value) )
 	{
-		led_write(false);
-		
-		if( current_position_right.value.int_value < target_position_right.value.int_value )
-		{
-			gpio_write(right_blind_open, true);
-			gpio_write(right_blind_close, false);
-			if( right_timer > 0 )
-			{
-				right_timer -= poll_time;
-				if( right_timer <= 0 )
-					right_timer = 0;
-				
-				if( target_position_right.value.int_value != current_position_right.value.int_value + TIMER_TO_PCT_R_OPEN(right_timer) )
-				{
-					current_position_right.value.int_value = target_position_right.value.int_value - TIMER_TO_PCT_R_OPEN(right_timer);
-					homekit_characteristic_notify(&current_position_right, current_position_right.value);
-					led_write(true);
-					printf("open R current: %d target: %d timer %d\n", current_position_right.value.int_value, target_position_right.value.int_value, right_timer);
-				}			
-			}
-			else
-			{
-				right_timer = poll_time;
-			}
-		}
-		else if( current_position_right.value.int_value > target_position_right.value.int_value )
-		{
-			gpio_write(right_blind_open, false);
-			gpio_write(right_blind_close, true);
-			if( right_timer > 0 )
-			{
-				right_timer -= poll_time;
-				if( right_timer <= 0 )
-					right_timer = 0;
-				
-				if( target_position_right.value.int_value != current_position_right.value.int_value - TIMER_TO_PCT_R_CLOSE(right_timer) )
-				{
-					current_position_right.value.int_value = target_position_right.value.int_value + TIMER_TO_PCT_R_CLOSE(right_timer);
-					homekit_characteristic_notify(&current_position_right, current_position_right.value);
-					led_write(true);
-					printf("close R current: %d target: %d timer %d\n", current_position_right.value.int_value, target_position_right.value.int_value, right_timer);
-				}			
-			}
-			else
-			{
-				right_timer = poll_time;
-			}
-		}
-		else
-		{
-			gpio_write(right_blind_open, false);
-			gpio_write(right_blind_close, false);
-		}
+		printf("Failed to initialize blinds\n");
+	}
+}
 
-		if( current_position_left.value.int_value < target_position_left.value.int_value )
-		{
-			gpio_write(left_blind_open, true);
-			gpio_write(left_blind_close, false);
-			if( left_timer > 0 )
-			{
-				left_timer -= poll_time;
-				if( left_timer <= 0 )
-					left_timer = 0;
-				
-				if( target_position_left.value.int_value != current_position_left.value.int_value + TIMER_TO_PCT_L_OPEN(left_timer) )
-				{
-					current_position_left.value.int_value = target_position_left.value.int_value - TIMER_TO_PCT_L_OPEN(left_timer);
-					homekit_characteristic_notify(&current_position_left, current_position_left.value);
-					led_write(true);
-					printf("open L current: %d target: %d timer %d\n", current_position_left.value.int_value, target_position_left.value.int_value, left_timer);
-				}			
-			}
-			else
-			{
-				left_timer = poll_time;
-			}
-		}
-		else if( current_position_left.value.int_value > target_position_left.value.int_value )
+typedef struct {
+	cover_t *cover;
+	homekit_characteristic_t *target_position;
+	bool open;
+} remote_t;
+
+remote_t remotes[] = {
+	{ &left_blind, &target_position_left, false },
+	{ &left_blind, &target_position_left, true },
+	{ &right_blind, &target_position_right, false },
+	{ &right_blind, &target_position_right, true },
+};
+
+// Remote buttons move blind while held, or past the limit to adjust it
+void remote_handler(uint8_t gpio_num, bool level, uint32_t time, void *context)
+{
+	remote_t *remote = context;
+	cover_t *cover = remote->cover;
+
+	if( level )
+	{
+		int target = remote->open ? remote->target_position->max_value[0] : remote->target_position->min_value[0];
+
+		if( cover_get_state(cover) == cover_state_stopped && cover_get_position(cover) == target )
 		{
-			gpio_write(left_blind_open, false);
-			gpio_write(left_blind_close, true);
-			if( left_timer > 0 )
-			{
-				left_timer -= poll_time;
-				if( left_timer <= 0 )
-					left_timer = 0;
-				
-				if( target_position_left.value.int_value != current_position_left.value.int_value - TIMER_TO_PCT_L_CLOSE(left_timer) )
-				{
-					current_position_left.value.int_value = target_position_left.value.int_value + TIMER_TO_PCT_L_CLOSE(left_timer);
-					homekit_characteristic_notify(&current_position_left, current_position_left.value);
-					led_write(true);
-					printf("close L current: %d target: %d timer %d\n", current_position_left.value.int_value, target_position_left.value.int_value, left_timer);
-				}			
-			}
-			else
-			{
-				left_timer = poll_time;
-			}
+			// allow remote to adjust past limit
+			blind_motor(cover, remote->open ? cover_state_opening : cover_state_closing);
+			return;
 		}
+
+		remote->target_position->value.int_value = target;
+		homekit_characteristic_notify(remote->target_position, remote->target_position->value);
+		cover_set_target(cover, target);
+	}
+	else
+	{
+		if( cover_get_state(cover) == cover_state_stopped )
+			blind_motor(cover, cover_state_stopped);
 		else
-		{
-			gpio_write(left_blind_open, false);
-			gpio_write(left_blind_close, false);
-		}
+			cover_stop(cover);
+	}
+}
 
+void remotes_init()
+{
+	const int remote_gpios[] = { remote_left_close, remote_left_open, remote_right_close, remote_right_open };
 
-		//if(gpio_read(remote_valid))	// valid input from remote - not enough inputs!
-		//{
-			if( gpio_read(remote_left_close) )
-			{
-				if( target_position_left.value.int_value > target_position_left.min_value[0] )
-				{
-					if(target_position_left.value.int_value == current_position_left.value.int_value)
-					{
-						target_position_left.value.int_value = current_position_left.value.int_value - 1;
-						homekit_characteristic_notify(&target_position_left, target_position_left.value);
-						left_timer += blind_one_pct_time;
-					}
-				}	
-				else	// allow remote to adjust close past limit
-				{
-					gpio_write(left_blind_open, false);
-					gpio_write(left_blind_close, true);
-				}
-			}
-			else if( gpio_read(remote_left_open) )
-			{
-				if( target_position_left.value.int_value < target_position_left.max_value[0] )
-				{
-					if(target_position_left.value.int_value == current_position_left.value.int_value)
-					{
-						target_position_left.value.int_value = current_position_left.value.int_value + 1;
-						homekit_characteristic_notify(&target_position_left, target_position_left.value);
-						left_timer += blind_one_pct_time;
-					}
-				}
-				else	// allow remote to adjust open past limit
-				{
-					gpio_write(left_blind_open, true);
-					gpio_write(left_blind_close, false);
-				}
-			}
-			if( gpio_read(remote_right_close) )
-			{					
-				if( target_position_right.value.int_value > target_position_right.min_value[0] )
-				{
-					if(target_position_right.value.int_value == current_position_right.value.int_value )
-					{
-						target_position_right.value.int_value = current_position_right.value.int_value - 1;
-						homekit_characteristic_notify(&target_position_right, target_position_right.value);
-						right_timer += blind_one_pct_time;
-					}
-				}
-				else	// allow remote to adjust close past limit
-				{
-					gpio_write(right_blind_open, false);
-					gpio_write(right_blind_close, true);
-				}
-			}
-			else if( gpio_read(remote_right_open) )
-			{
-				if( target_position_right.value.int_value < target_position_right.max_value[0] )
-				{
-					if(target_position_right.value.int_value == current_position_right.value.int_value)
-					{
-						target_position_right.value.int_value = current_position_right.value.int_value + 1;
-						homekit_characteristic_notify(&target_position_right, target_position_right.value);
-						right_timer += blind_one_pct_time;
-					}
-				}
-				else	// allow remote to adjust open past limit
-				{
-					gpio_write(right_blind_open, true);
-					gpio_write(right_blind_close, false);
-				}
-			}
-		//}
-		
-
-		vTaskDelay(poll_time);
+//	gpio_enable(remote_valid, GPIO_INPUT);
+	for( int i = 0; i < 4; i++ )
+	{
+		gpio_enable(remote_gpios[i], GPIO_INPUT);
+		if( gpio_input_attach(remote_gpios[i], GPIO_INTTYPE_EDGE_ANY, remote_handler, &remotes[i]) )
+			printf("Failed to initialize remote input at GPIO %d\n", remote_gpios[i]);
 	}
-
 }
 
 
 void on_update_right(homekit_characteristic_t *ch, homekit_value_t value, void *context)
 {
-	int percent = current_position_right.value.int_value - target_position_right.value.int_value;
-	
-	if( percent < 0 ) 
-		right_timer = right_blind_open_time * (-percent) / 100;
-	else
-		right_timer = right_blind_close_time * percent / 100;
-	
-	printf("R:current: %d target: %d timer %d\n", current_position_right.value.int_value, target_position_right.value.int_value, right_timer);
+	cover_set_target(&right_blind, target_position_right.value.int_value);
 }
 
 void on_update_left(homekit_characteristic_t *ch, homekit_value_t value, void *context)
 {
-	int percent = current_position_left.value.int_value - target_position_left.value.int_value;
-	
-	if( percent < 0 ) 
-		left_timer = left_blind_open_time * (-percent) / 100;
-	else
-		left_timer = left_blind_close_time * percent / 100;
-	
-	printf("L:current: %d target: %d timer %d\n", current_position_left.value.int_value, target_position_left.value.int_value, left_timer);
+	cover_set_target(&left_blind, target_position_left.value.int_value);
 }
 
 
@@ -478,6 +395,7 @@ void user_init(void) {
 
     wifi_init();
     led_init();
+    blinds_init();
     homekit_server_init(&config);
-    xTaskCreate(main_task, "Main", 512, NULL, 2, NULL);
+    remotes_init();
 }
@@ -9,12 +9,17 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
-#include "contact_sensor.h"
+#include <contact_sensor.h>
 
 #ifndef REED_PIN
 #error REED_PIN is not specified
 #endif
 
+// Reed switch has to be stable for this long, in milliseconds
+#define DOOR_SETTLE_TIME 50
+// Door swinging near the magnet is reported once, in milliseconds
+#define DOOR_COALESCE_TIME 500
+
 
 static void wifi_init() {
     struct sdk_station_config wifi_config = {
@@ -54,14 +59,16 @@ homekit_characteristic_t door_open_characteristic = HOMEKIT_CHARACTERISTIC_(CONT
 );
 
 /**
- * Called (indirectly) from the interrupt handler to notify the client of a state change.
+ * Called from the input worker task once the reed switch has settled.
+ * Bounces within DOOR_COALESCE_TIME of a change are reported as one event.
  **/
 void contact_sensor_callback(uint8_t gpio, contact_sensor_state_t state) {
     switch (state) {
         case CONTACT_OPEN:
         case CONTACT_CLOSED:
             printf("Pushing contact sensor state '%s'.\n", state == CONTACT_OPEN ? "open" : "closed");
-            homekit_characteristic_notify(&door_open_characteristic, door_state_getter());
+            door_open_characteristic.value = HOMEKIT_UINT8(state == CONTACT_OPEN ? 1 : 0);
+            homekit_characteristic_notify(&door_open_characteristic, door_open_characteristic.value);
             break;
         default:
             printf("Unknown contact sensor event: %d\n", state);
@@ -115,7 +122,11 @@ void user_init(void) {
 
     wifi_init();
     printf("Using Sensor at GPIO%d.\n", REED_PIN);
-    if (contact_sensor_create(REED_PIN, contact_sensor_callback)) {
+    contact_sensor_config_t sensor_config = CONTACT_SENSOR_CONFIG(
+        .settle_time = DOOR_SETTLE_TIME,
+        .coalesce_time = DOOR_COALESCE_TIME,
+    );
+    if (contact_sensor_create_ex(REED_PIN, &sensor_config, contact_sensor_callback)) {
         printf("Failed to initialize door\n");
     }
     homekit_server_init(&config);
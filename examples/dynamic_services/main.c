@@ -10,12 +10,12 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <accessory_builder.h>
+#include <actuator.h>
 
 #include "wifi.h"
 
 
-#define MAX_SERVICES 20
-
 
 static void wifi_init() {
     struct sdk_station_config wifi_config = {
@@ -36,10 +36,13 @@ const uint8_t relay_gpios[] = {
 };
 const size_t relay_count = sizeof(relay_gpios) / sizeof(*relay_gpios);
 
+char relay_names[sizeof(relay_gpios)][10];
+int relay_channels[sizeof(relay_gpios)];
+
 
-void relay_write(int relay, bool on) {
-    printf("Relay %d %s\n", relay, on ? "ON" : "OFF");
-    gpio_write(relay, on ? 1 : 0);
+void relay_write(int channel, bool on) {
+    printf("Relay %d %s\n", channel, on ? "ON" : "OFF");
+    actuator_set(channel, on);
 }
 
 void led_write(bool on) {
@@ -51,26 +54,37 @@ void gpio_init() {
     led_write(false);
 
     for (int i=0; i < relay_count; i++) {
-        gpio_enable(relay_gpios[i], GPIO_OUTPUT);
-        relay_write(relay_gpios[i], true);
+        snprintf(relay_names[i], sizeof(relay_names[i]), "Relay %d", i + 1);
+
+        actuator_config_t relay_config = {
+            .name = relay_names[i],
+            .gpio = relay_gpios[i],
+        };
+        relay_channels[i] = actuator_add(&relay_config);
+        if (relay_channels[i] < 0) {
+            printf("Failed to initialize %s\n", relay_names[i]);
+            continue;
+        }
+
+        relay_write(relay_channels[i], true);
     }
 }
 
 void lamp_identify_task(void *_args) {
-    relay_write(relay_gpios[0], true);
+    relay_write(relay_channels[0], true);
 
     for (int i=0; i<3; i++) {
         for (int j=0; j<2; j++) {
-            relay_write(relay_gpios[0], true);
+            relay_write(relay_channels[0], true);
             vTaskDelay(100 / portTICK_PERIOD_MS);
-            relay_write(relay_gpios[0], false);
+            relay_write(relay_channels[0], false);
             vTaskDelay(100 / portTICK_PERIOD_MS);
         }
 
         vTaskDelay(250 / portTICK_PERIOD_MS);
     }
 
-    relay_write(relay_gpios[0], true);
+    relay_write(relay_channels[0], true);
 
     vTaskDelete(NULL);
 }
@@ -81,15 +95,12 @@ void lamp_identify(homekit_value_t _value) {
 }
 
 void relay_callback(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
-    uint8_t *gpio = context;
-    relay_write(*gpio, value.bool_value);
+    int *channel = context;
+    relay_write(*channel, value.bool_value);
 }
 
 
-homekit_accessory_t *accessories[2];
-
 homekit_server_config_t config = {
-    .accessories = accessories,
     .password = "111-11-111"
 };
 
@@ -98,59 +109,59 @@ void on_wifi_ready() {
 }
 
 
-void init_accessory() {
+void build_accessory(accessory_builder_t *builder, void *context) {
     uint8_t macaddr[6];
     sdk_wifi_get_macaddr(STATION_IF, macaddr);
 
-    int name_len = snprintf(NULL, 0, "Relays-%02X%02X%02X",
-                            macaddr[3], macaddr[4], macaddr[5]);
-    char *name_value = malloc(name_len+1);
-    snprintf(name_value, name_len+1, "Relays-%02X%02X%02X",
-             macaddr[3], macaddr[4], macaddr[5]);
-
-    homekit_service_t* services[MAX_SERVICES + 1];
-    homekit_service_t** s = services;
-
-    *(s++) = NEW_HOMEKIT_SERVICE(ACCESSORY_INFORMATION, .characteristics=(homekit_characteristic_t*[]) {
-        NEW_HOMEKIT_CHARACTERISTIC(NAME, name_value),
-        NEW_HOMEKIT_CHARACTERISTIC(MANUFACTURER, "HaPK"),
-        NEW_HOMEKIT_CHARACTERISTIC(SERIAL_NUMBER, "0"),
-        NEW_HOMEKIT_CHARACTERISTIC(MODEL, "Relays"),
-        NEW_HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"),
-        NEW_HOMEKIT_CHARACTERISTIC(IDENTIFY, lamp_identify),
-        NULL
-    });
+    accessory_builder_accessory(builder, HOMEKIT_ACCESSORY(.category=homekit_accessory_category_other));
+
+    accessory_builder_service(builder, HOMEKIT_SERVICE(ACCESSORY_INFORMATION));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(
+        NAME, accessory_builder_printf(builder, "Relays-%02X%02X%02X",
+                                       macaddr[3], macaddr[4], macaddr[5])
+    ));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(MANUFACTURER, "HaPK"));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(SERIAL_NUMBER, "0"));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(MODEL, "Relays"));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(IDENTIFY, lamp_identify));
 
     for (int i=0; i < relay_count; i++) {
-        int relay_name_len = snprintf(NULL, 0, "Relay %d", i + 1);
-        char *relay_name_value = malloc(relay_name_len+1);
-        snprintf(relay_name_value, relay_name_len+1, "Relay %d", i + 1);
-
-        *(s++) = NEW_HOMEKIT_SERVICE(LIGHTBULB, .characteristics=(homekit_characteristic_t*[]) {
-            NEW_HOMEKIT_CHARACTERISTIC(NAME, relay_name_value),
-            NEW_HOMEKIT_CHARACTERISTIC(
-                ON, true,
-                .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(
-                    relay_callback, .context=(void*)&relay_gpios[i]
-                ),
+        accessory_builder_service(builder, HOMEKIT_SERVICE(LIGHTBULB));
+        accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(NAME, relay_names[i]));
+        accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(
+            ON, true,
+            .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(
+                relay_callback, .context=(void*)&relay_channels[i]
             ),
-            NULL
-        });
+        ));
     }
+}
 
-    *(s++) = NULL;
+int init_accessory() {
+    accessory_builder_stats_t stats;
+    config.accessories = accessory_builder_build(build_accessory, NULL, &stats);
+    if (!config.accessories) {
+        printf("Failed to build accessory\n");
+        return -1;
+    }
 
-    accessories[0] = NEW_HOMEKIT_ACCESSORY(.category=homekit_accessory_category_other, .services=services);
-    accessories[1] = NULL;
+    printf("Accessory database: %u bytes, %u objects, %u allocations\n",
+           (unsigned) stats.bytes, stats.objects, stats.allocations);
+    return 0;
 }
 
 void user_init(void) {
     uart_set_baud(0, 115200);
 
-    init_accessory();
-
+    // Relay channel names are used as service names
     gpio_init();
 
+    if (init_accessory()) {
+        printf("Not starting HomeKit server\n");
+        return;
+    }
+
     wifi_init();
     on_wifi_ready();
 }
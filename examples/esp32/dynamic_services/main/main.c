@@ -11,11 +11,10 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <accessory_builder.h>
 #include "wifi.h"
 
 
-#define MAX_SERVICES 20
-
 
 void on_wifi_ready();
 
@@ -112,57 +111,52 @@ void relay_callback(homekit_characteristic_t *ch, homekit_value_t value, void *c
     relay_write(*gpio, value.bool_value);
 }
 
-homekit_accessory_t *accessories[2];
-
 homekit_server_config_t config = {
-    .accessories = accessories,
     .password = "111-11-111"
 };
 
-void init_accessory() {
+void build_accessory(accessory_builder_t *builder, void *context) {
     uint8_t macaddr[6];
     esp_read_mac(macaddr, ESP_MAC_WIFI_STA);
 
-    int name_len = snprintf(NULL, 0, "Relays-%02X%02X%02X",
-                            macaddr[3], macaddr[4], macaddr[5]);
-    char *name_value = malloc(name_len+1);
-    snprintf(name_value, name_len+1, "Relays-%02X%02X%02X",
-             macaddr[3], macaddr[4], macaddr[5]);
-
-    homekit_service_t* services[MAX_SERVICES + 1];
-    homekit_service_t** s = services;
-
-    *(s++) = NEW_HOMEKIT_SERVICE(ACCESSORY_INFORMATION, .characteristics=(homekit_characteristic_t*[]) {
-        NEW_HOMEKIT_CHARACTERISTIC(NAME, name_value),
-        NEW_HOMEKIT_CHARACTERISTIC(MANUFACTURER, "HaPK"),
-        NEW_HOMEKIT_CHARACTERISTIC(SERIAL_NUMBER, "0"),
-        NEW_HOMEKIT_CHARACTERISTIC(MODEL, "Relays"),
-        NEW_HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"),
-        NEW_HOMEKIT_CHARACTERISTIC(IDENTIFY, identify),
-        NULL
-    });
+    accessory_builder_accessory(builder, HOMEKIT_ACCESSORY(.category=homekit_accessory_category_other));
+
+    accessory_builder_service(builder, HOMEKIT_SERVICE(ACCESSORY_INFORMATION));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(
+        NAME, accessory_builder_printf(builder, "Relays-%02X%02X%02X",
+                                       macaddr[3], macaddr[4], macaddr[5])
+    ));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(MANUFACTURER, "HaPK"));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(SERIAL_NUMBER, "0"));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(MODEL, "Relays"));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(FIRMWARE_REVISION, "0.1"));
+    accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(IDENTIFY, identify));
 
     for (int i=0; i < relay_count; i++) {
-        int relay_name_len = snprintf(NULL, 0, "Relay %d", i + 1);
-        char *relay_name_value = malloc(name_len+1);
-        snprintf(relay_name_value, relay_name_len+1, "Relay %d", i + 1);
-
-        *(s++) = NEW_HOMEKIT_SERVICE(LIGHTBULB, .characteristics=(homekit_characteristic_t*[]) {
-            NEW_HOMEKIT_CHARACTERISTIC(NAME, relay_name_value),
-            NEW_HOMEKIT_CHARACTERISTIC(
-                ON, true,
-                .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(
-                    relay_callback, .context=(void*)&relay_gpios[i]
-                ),
+        accessory_builder_service(builder, HOMEKIT_SERVICE(LIGHTBULB));
+        accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(
+            NAME, accessory_builder_printf(builder, "Relay %d", i + 1)
+        ));
+        accessory_builder_characteristic(builder, HOMEKIT_CHARACTERISTIC(
+            ON, true,
+            .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(
+                relay_callback, .context=(void*)&relay_gpios[i]
             ),
-            NULL
-        });
+        ));
     }
+}
 
-    *(s++) = NULL;
+int init_accessory() {
+    accessory_builder_stats_t stats;
+    config.accessories = accessory_builder_build(build_accessory, NULL, &stats);
+    if (!config.accessories) {
+        printf("Failed to build accessory\n");
+        return -1;
+    }
 
-    accessories[0] = NEW_HOMEKIT_ACCESSORY(.category=homekit_accessory_category_other, .services=services);
-    accessories[1] = NULL;
+    printf("Accessory database: %u bytes, %u objects, %u allocations\n",
+           (unsigned) stats.bytes, stats.objects, stats.allocations);
+    return 0;
 }
 
 void on_wifi_ready() {
@@ -180,6 +174,12 @@ void app_main(void) {
 
     gpio_init();
 
+    // Server is started once WiFi is up, so there has to be
+    // an accessory database before connecting
+    if (init_accessory()) {
+        printf("Not starting HomeKit server\n");
+        return;
+    }
+
     wifi_init();
-    init_accessory();
 }
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fire.h"
+
+#define FIRE_CELL_MAX ((fire_cell_t)~0)
+
+
+static inline uint32_t fire_random(fire_t *fire) {
+    // xorshift32
+    uint32_t x = fire->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fire->random = x;
+    return x;
+}
+
+// Random number in range [0, n) without a division
+static inline uint32_t fire_random_range(fire_t *fire, uint32_t n) {
+    return ((fire_random(fire) >> 16) * n) >> 16;
+}
+
+
+// Cooling is computed in 1/256 palette index units, cells keep
+// FIRE_CELL_SHIFT of those bits, the rest is fraction
+#define FIRE_COOLING_FRAC (8 - FIRE_CELL_SHIFT)
+
+// Random number in range [0, n) in cell units, for n in 1/256 palette
+// index units (at most 17 bits). Fraction of the result is rounded up
+// with matching probability, so ranges below one cell unit (cooling of
+// tall fires with 8-bit cells) keep their average instead of becoming 0.
+static inline uint32_t fire_random_range_frac(fire_t *fire, uint32_t n) {
+    const uint32_t mask = (1 << FIRE_COOLING_FRAC) - 1;
+    uint32_t r = fire_random(fire);
+    // 15 random bits keep the product in 32 bits
+    uint32_t x = ((r >> 17) * n) >> 15;
+    return (x >> FIRE_COOLING_FRAC) + ((r & mask) < (x & mask));
+}
+
+
+size_t fire_size(uint8_t width, uint8_t height) {
+    return sizeof(fire_t) + width * height * sizeof(fire_cell_t);
+}
+
+
+fire_t *fire_new(uint8_t width, uint8_t height, uint8_t cooling, uint32_t seed) {
+    fire_t *fire = malloc(fire_size(width, height));
+    if (!fire)
+        return NULL;
+
+    memset(fire, 0, fire_size(width, height));
+    fire->width = width;
+    fire->height = height;
+    fire->cooling = cooling;
+    fire->random = seed ? seed : 1;
+
+    return fire;
+}
+
+
+void fire_free(fire_t *fire) {
+    free(fire);
+}
+
+
+void fire_update(fire_t *fire, uint8_t intensity) {
+    const uint8_t width = fire->width;
+    const uint8_t height = fire->height;
+    fire_cell_t *cells = fire->cells;
+
+    // Per-frame constants, converted to palette index units. Sparks reach
+    // up to intensity * 2, cooling is spread over the height of the fire.
+    uint32_t cooling = ((uint32_t)fire->cooling * 2 << 8) / height;
+    uint32_t hot = ((uint32_t)intensity * 2 << FIRE_CELL_SHIFT) / height;
+    uint32_t max_hot = (uint32_t)intensity * 2 << FIRE_CELL_SHIFT;
+    if (max_hot > FIRE_CELL_MAX)
+        max_hot = FIRE_CELL_MAX;
+
+    // 1. Cool all the sparks and ignite new ones at the bottom
+    for (int i = 0; i < width; i++) {
+        fire_cell_t *column = &cells[i * height];
+        for (int j = 0; j < height; j++) {
+            uint32_t c = fire_random_range_frac(fire, cooling);
+            column[j] = (column[j] < c) ? 0 : column[j] - c;
+        }
+
+        if (column[0] < hot) {
+            column[0] = hot + fire_random_range(fire, max_hot - hot);
+        }
+    }
+
+    // 2. Heat drifts up and spreads to the sides
+    for (int i = 0; i < width; i++) {
+        fire_cell_t *column = &cells[i * height];
+        for (int j = height - 1; j > 0; j--) {
+            uint32_t heat = column[j] + column[j-1];
+            if (i > 0)
+                heat += column[j - 1 - height];
+            if (i < width - 1)
+                heat += column[j - 1 + height];
+
+            // heat / 6
+            column[j] = (heat * 171) >> 10;
+        }
+    }
+}
+
+
+static inline uint8_t scale(uint8_t x, uint8_t s) {
+    return (((uint16_t)x) * s) >> 8;
+}
+
+void fire_palette_build(const ws2812_pixel_t palette[16], ws2812_pixel_t table[256]) {
+    for (int index = 0; index < 256; index++) {
+        // High 4 bits of index pick two palette colors,
+        // lower 4 bits are used to interpolate between them.
+        ws2812_pixel_t lo_color = palette[index >> 4];
+        if (!(index & 0xf) || (index >> 4) == 15) {
+            table[index] = lo_color;
+            continue;
+        }
+
+        ws2812_pixel_t hi_color = palette[(index >> 4) + 1];
+        uint8_t s2 = (index & 0xf) << 4;
+        uint8_t s1 = 255 - s2;
+
+        table[index] = (ws2812_pixel_t) {
+            .red = scale(lo_color.red, s1) + scale(hi_color.red, s2),
+            .green = scale(lo_color.green, s1) + scale(hi_color.green, s2),
+            .blue = scale(lo_color.blue, s1) + scale(hi_color.blue, s2),
+        };
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Heat diffusion fire simulation.
+ *
+ * Grid is stored column by column, row 0 is the bottom of the fire.
+ * Cell heat is kept in palette index units (shifted by FIRE_CELL_SHIFT
+ * for 16-bit cells), so rendering is a table lookup per pixel.
+ * Uses integer math only: xorshift PRNG, multiply-shift instead of
+ * divisions.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ws2812_i2s/ws2812_i2s.h>
+
+// Cell storage size: 8 bits is enough for the visual effect and halves
+// RAM for large grids, 16 bits keeps fractional heat for smoother fire.
+#ifndef FIRE_CELL_BITS
+#define FIRE_CELL_BITS 8
+#endif
+
+#if FIRE_CELL_BITS == 16
+typedef uint16_t fire_cell_t;
+#define FIRE_CELL_SHIFT 8
+#elif FIRE_CELL_BITS == 8
+typedef uint8_t fire_cell_t;
+#define FIRE_CELL_SHIFT 0
+#else
+#error FIRE_CELL_BITS should be 8 or 16
+#endif
+
+typedef struct {
+    uint8_t width;
+    uint8_t height;
+    uint8_t cooling;
+    uint32_t random;
+
+    fire_cell_t cells[];
+} fire_t;
+
+/**
+    @return Number of bytes of RAM used by fire state of given size
+*/
+size_t fire_size(uint8_t width, uint8_t height);
+
+/**
+    Allocates fire state.
+
+    @param width Number of columns
+    @param height Number of rows
+    @param cooling Rate of cooling. Larger values make for weaker fire.
+    @param seed Random seed, should not be 0
+    @return Fire state or NULL if there is not enough memory
+*/
+fire_t *fire_new(uint8_t width, uint8_t height, uint8_t cooling, uint32_t seed);
+
+void fire_free(fire_t *fire);
+
+/**
+    Advances fire simulation by one frame.
+
+    @param fire Fire state
+    @param intensity Heat of new sparks (0-255)
+*/
+void fire_update(fire_t *fire, uint8_t intensity);
+
+/**
+    Builds 256 entry heat color table by interpolating 16 color palette.
+*/
+void fire_palette_build(const ws2812_pixel_t palette[16], ws2812_pixel_t table[256]);
+
+/**
+    @return Palette index (0-255) of given cell
+*/
+static inline uint8_t fire_heat(const fire_t *fire, uint8_t x, uint8_t y) {
+    return fire->cells[x * fire->height + y] >> FIRE_CELL_SHIFT;
+}
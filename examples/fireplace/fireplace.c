@@ -30,8 +30,11 @@
 #include <homekit/characteristics.h>
 
 #include <ws2812_i2s/ws2812_i2s.h>
+#include <led_matrix.h>
+#include <animation.h>
 
 #include "wifi.h"
+#include "fire.h"
 
 static void wifi_init() {
     struct sdk_station_config wifi_config = {
@@ -44,25 +47,37 @@ static void wifi_init() {
     sdk_wifi_station_connect();
 }
 
+void fireplace_on_update(homekit_characteristic_t *ch, homekit_value_t value, void *context);
+
+homekit_characteristic_t on = HOMEKIT_CHARACTERISTIC_(
+    ON, true, .callback=HOMEKIT_CHARACTERISTIC_CALLBACK(fireplace_on_update)
+);
 homekit_characteristic_t brightness = HOMEKIT_CHARACTERISTIC_(BRIGHTNESS, 50);
 
 
-/* Board shape and size configuration. Sheild is 6x10, 60 pixels */
+/* Board shape and size configuration. Sheild is 6x10, 60 pixels.
+   Can be overridden from Makefile for larger boards. */
+#ifndef HEIGHT
 #define HEIGHT 10
+#endif
+#ifndef WIDTH
 #define WIDTH 6
+#endif
 #define NUM_LEDS (HEIGHT*WIDTH)
 
 /* Refresh rate. Higher makes for flickerier
    Recommend small values for small displays */
+#ifndef FPS
 #define FPS 17
-#define FPS_DELAY (1000 / FPS / portTICK_PERIOD_MS)
+#endif
+#define FPS_PERIOD (1000 / FPS)
 
 /* Rate of cooling. Play with to change fire from
    roaring (larger values) to weak (smaller values) */
 #define COOLING 55
 
 
-ws2812_pixel_t heat_colors[16] = {
+const ws2812_pixel_t heat_colors[16] = {
     { .color=0x000000 },
     { .color=0x330000 },
     { .color=0x660000 },
@@ -81,178 +96,131 @@ ws2812_pixel_t heat_colors[16] = {
     { .color=0xffffff },
 };
 
-static int min(int a, int b) {
-    return (a > b) ? b : a;
-}
-
-uint8_t scale(uint8_t x, uint8_t s) {
-    return (((uint16_t)x) * s) >> 8;
-}
-
-ws2812_pixel_t heat_color(uint8_t index) {
-    // Since palette is only 16 colors, uses high 4 bits if index
-    // to pick to palette colors and lower 4 bits to interpolate
-    // between those two colors.
-    ws2812_pixel_t lo_color = heat_colors[index >> 4];
-    if (!(index & 0xf))
-        return lo_color;
-
-    ws2812_pixel_t hi_color = heat_colors[min((index >> 4) + 1, 15)];
-    uint8_t s2 = (index & 0xf) << 4;
-    uint8_t s1 = 255 - s2;
-
-    return (ws2812_pixel_t) {
-        .red = scale(lo_color.red, s1) + scale(hi_color.red, s2),
-        .green = scale(lo_color.green, s1) + scale(hi_color.green, s2),
-        .blue = scale(lo_color.blue, s1) + scale(hi_color.blue, s2),
-    };
-}
-
-
+ws2812_pixel_t heat_table[256];
 
 ws2812_pixel_t pixels[NUM_LEDS];
-bool fireplace_on = false;
+led_matrix_t *matrix = NULL;
+fire_t *fire = NULL;
 
-void fireplace_update() {
-    // Update fire animation
-    static unsigned int stack[WIDTH][HEIGHT] = {};
+/* Identify pre-empts fire animation, both share the same strip */
+#define FIREPLACE_PRIORITY_FIRE 0
+#define FIREPLACE_PRIORITY_IDENTIFY 1
 
-    unsigned int hot = 256 * brightness.value.int_value / 100;
-    unsigned int maxhot = hot * HEIGHT;
+/* Identify sweeps a column back and forth twice */
+#define IDENTIFY_STEP 100
+#if WIDTH < 2
+#error "Identify sweep needs WIDTH of at least 2"
+#endif
+#define IDENTIFY_SWEEP (2*WIDTH - 2)
+#define IDENTIFY_FRAMES (2*IDENTIFY_SWEEP)
 
-    // 1. Cool all the sparks
-    for(int i=0; i < WIDTH; i++) {
-        for (int j=0; j < HEIGHT; j++) {
-            unsigned int cooling = hwrand() % COOLING;
-            stack[i][j] = (stack[i][j] < cooling) ? 0 : stack[i][j] - cooling;
-        }
-
-        if (stack[i][0] < hot) {
-            stack[i][0] = hot + hwrand() % (maxhot - hot);
-        }
-    }
-
-    for( int i = 0; i < WIDTH; i++) {
-        for( int j = HEIGHT-1; j > 0; j--) {
-            unsigned long heat = stack[i][j] + stack[i][j-1];
-            if (i > 0)
-                heat += stack[i-1][j-1];
-            if (i < WIDTH-1)
-                heat += stack[i+1][j-1];
+void fireplace_clear() {
+    memset(pixels, 0, sizeof(pixels));
+    ws2812_i2s_update(pixels, PIXEL_RGB);
+}
 
-            stack[i][j] = heat / 6;
-        }
-    }
+int fireplace_step(animation_t *animation) {
+    fire_update(fire, 255 * brightness.value.int_value / 100);
 
     for (int i = 0; i < WIDTH; i++) {
         for (int j = 0; j < HEIGHT; j++) {
-            uint8_t index = ((unsigned long)stack[i][j]) / HEIGHT * 2;
-            ws2812_pixel_t color = heat_color(index);
-
-            if (i % 2 == 0) {
-                pixels[(i*HEIGHT) + j] = color;
-            } else {
-                pixels[(i*HEIGHT) + HEIGHT - j - 1] = color;
-            }
+            pixels[led_matrix_index(matrix, i, j)] = heat_table[fire_heat(fire, i, j)];
         }
     }
 
     ws2812_i2s_update(pixels, PIXEL_RGB);
-}
 
-void fireplace_clear() {
-    memset(pixels, 0, sizeof(pixels));
-    ws2812_i2s_update(pixels, PIXEL_RGB);
+    return FPS_PERIOD;
 }
 
-void fireplace_task(void *_arg) {
-    while (fireplace_on) {
-        fireplace_update();
-
-        vTaskDelay(FPS_DELAY);
-    }
-
+void fireplace_finish(animation_t *animation) {
     fireplace_clear();
-    vTaskDelete(NULL);
-}
-
-void fireplace_init() {
-    ws2812_i2s_init(NUM_LEDS, PIXEL_RGB);
-    memset(pixels, 0, sizeof(pixels));
 }
 
-void fireplace_start() {
-    fireplace_on = true;
-    xTaskCreate(fireplace_task, "Fireplace", 256, NULL, 2, NULL);
-}
+animation_t fireplace_animation = {
+    .step = fireplace_step,
+    .on_finish = fireplace_finish,
+    .priority = FIREPLACE_PRIORITY_FIRE,
+};
 
 void _fill_column(int column, ws2812_pixel_t color) {
-    if (column % 2 == 0) {
-        for (int j = 0; j < HEIGHT; j++)
-            pixels[(column*HEIGHT) + j] = color;
-    } else {
-        for (int j = 0; j < HEIGHT; j++)
-            pixels[(column*HEIGHT) + HEIGHT - j - 1] = color;
-    }
+    for (int j = 0; j < HEIGHT; j++)
+        pixels[led_matrix_index(matrix, column, j)] = color;
 }
 
-void fireplace_identify_task(void *_args) {
-    bool old_on = fireplace_on;
-    fireplace_on = false;
-    vTaskDelay(2*FPS_DELAY);
-
-    ws2812_pixel_t black = { .color=0x000000 };
+int fireplace_identify_step(animation_t *animation) {
     ws2812_pixel_t red = { .color=0x990000 };
 
     memset(pixels, 0, sizeof(pixels));
-    ws2812_i2s_update(pixels, PIXEL_RGB);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
 
-    for (int x = 0; x < 2; x++) {
-        for (int i = 0; i < WIDTH; i++) {
-            _fill_column(i, red);
+    // First frame is blank
+    if (animation->frame > 0) {
+        uint32_t step = animation->frame - 1;
+        if (step >= IDENTIFY_FRAMES) {
             ws2812_i2s_update(pixels, PIXEL_RGB);
-
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            _fill_column(i, black);
+            return ANIMATION_DONE;
         }
 
-        for (int i = WIDTH-2; i > 0; i--) {
-            _fill_column(i, red);
-            ws2812_i2s_update(pixels, PIXEL_RGB);
-
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            _fill_column(i, black);
-        }
+        step %= IDENTIFY_SWEEP;
+        _fill_column(step < WIDTH ? step : IDENTIFY_SWEEP - step, red);
     }
 
     ws2812_i2s_update(pixels, PIXEL_RGB);
 
-    if (old_on)
-        fireplace_start();
+    return IDENTIFY_STEP;
+}
+
+animation_t fireplace_identify_animation = {
+    .step = fireplace_identify_step,
+    .priority = FIREPLACE_PRIORITY_IDENTIFY,
+};
 
-    vTaskDelete(NULL);
+void fireplace_init() {
+    ws2812_i2s_init(NUM_LEDS, PIXEL_RGB);
+    memset(pixels, 0, sizeof(pixels));
+
+    fire_palette_build(heat_colors, heat_table);
+
+    matrix = led_matrix_new(WIDTH, HEIGHT, LED_MATRIX_COLUMNS | LED_MATRIX_SERPENTINE);
+    if (!matrix) {
+        printf("Failed to allocate matrix mapping\n");
+        return;
+    }
+
+    fire = fire_new(WIDTH, HEIGHT, COOLING, hwrand());
+    if (!fire) {
+        printf("Failed to allocate fire state\n");
+        return;
+    }
+    printf("Fireplace %dx%d, fire state %u bytes, heat table %u bytes\n",
+           WIDTH, HEIGHT, fire_size(WIDTH, HEIGHT), sizeof(heat_table));
+}
+
+void fireplace_start() {
+    if (!fire || !matrix)
+        return;
+
+    if (!animation_is_active(&fireplace_animation))
+        animation_start(&fireplace_animation);
 }
 
 void fireplace_identify(homekit_value_t _value) {
     printf("Fireplace identify\n");
-    xTaskCreate(fireplace_identify_task, "Fireplace identify", 256, NULL, 2, NULL);
-}
+    if (!matrix)
+        return;
 
-homekit_value_t fireplace_on_get() {
-    return HOMEKIT_BOOL(fireplace_on);
+    animation_start(&fireplace_identify_animation);
 }
 
-void fireplace_on_set(homekit_value_t value) {
-    if (value.format != homekit_format_bool) {
-        printf("Invalid value for fireplace ON characteristic: type=%d\n", value.format);
+void fireplace_on_update(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
+    if (value.bool_value == animation_is_active(&fireplace_animation))
         return;
-    }
 
-    if (value.bool_value && !fireplace_on) {
+    if (value.bool_value) {
         fireplace_start();
+    } else {
+        animation_stop(&fireplace_animation);
     }
-    fireplace_on = value.bool_value;
 }
 
 
@@ -269,11 +237,7 @@ homekit_accessory_t *accessories[] = {
         }),
         HOMEKIT_SERVICE(LIGHTBULB, .primary=true, .characteristics=(homekit_characteristic_t*[]){
             HOMEKIT_CHARACTERISTIC(NAME, "Fireplace"),
-            HOMEKIT_CHARACTERISTIC(
-                ON, false,
-                .getter=fireplace_on_get,
-                .setter=fireplace_on_set
-            ),
+            &on,
             &brightness,
             NULL
         }),
@@ -292,7 +256,10 @@ void user_init(void) {
     uart_set_baud(0, 115200);
 
     wifi_init();
+    animation_init();
     fireplace_init();
     fireplace_start();
+    // Fire does not run if there was not enough memory for it
+    on.value.bool_value = animation_is_active(&fireplace_animation);
     homekit_server_init(&config);
 }
@@ -12,7 +12,9 @@
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
-#include "contact_sensor.h"
+#include <contact_sensor.h>
+#include <actuator.h>
+#include <characteristic_index.h>
 
 // Possible values for characteristic CURRENT_DOOR_STATE:
 #define HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPEN 0
@@ -28,6 +30,12 @@
 
 #define OPEN_CLOSE_DURATION 22
 
+// Reed switch has to be stable for this long, in milliseconds
+#define REED_SETTLE_TIME 100
+
+// Length of the pulse that toggles the door, in milliseconds
+#define RELAY_PULSE_TIME 400
+
 const char *state_description(uint8_t state) {
     const char* description = "unknown";
     switch (state) {
@@ -100,16 +108,26 @@ homekit_accessory_t *accessories[] = {
 bool relay_on = false;
 uint8_t current_door_state = HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_UNKNOWN;
 ETSTimer update_timer; // used for delayed updating from contact sensor
+int relay_channel = -1;
 
 
 
 void relay_write(bool on) {
-    gpio_write(RELAY_PIN, on ? 0 : 1);
+    actuator_set(relay_channel, on);
 }
 
 void relay_init() {
-    gpio_enable(RELAY_PIN, GPIO_OUTPUT);
-    relay_write(relay_on);
+    actuator_config_t relay_config = {
+        .name = "Door",
+        .gpio = RELAY_PIN,
+        .active_low = true,
+        // Relay stays on for a full pulse even if switched off right away
+        .min_on_time = RELAY_PULSE_TIME,
+    };
+    relay_channel = actuator_add(&relay_config);
+    if (relay_channel < 0) {
+        printf("Failed to initialize relay\n");
+    }
 }
 
 void identify_task(void *_args) {
@@ -149,17 +167,37 @@ homekit_value_t gdo_obstruction_get() {
     return HOMEKIT_BOOL(false);
 }
 
+// Resolved once HomeKit server has assigned instance IDs, sensor changes
+// before that have no controllers to notify
+homekit_characteristic_t *current_door_state_ch = NULL;
+homekit_characteristic_t *target_door_state_ch = NULL;
+
+void gdo_characteristics_resolve() {
+    characteristic_index_t index;
+    if (characteristic_index_init(&index, accessories)) {
+        printf("Failed to index characteristics\n");
+        return;
+    }
+
+    current_door_state_ch = characteristic_index_by_type(
+        &index, 1, HOMEKIT_SERVICE_GARAGE_DOOR_OPENER, HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE
+    );
+    target_door_state_ch = characteristic_index_by_type(
+        &index, 1, HOMEKIT_SERVICE_GARAGE_DOOR_OPENER, HOMEKIT_CHARACTERISTIC_TARGET_DOOR_STATE
+    );
+    assert(current_door_state_ch && target_door_state_ch);
+
+    characteristic_index_free(&index);
+}
+
 void gdo_current_state_notify_homekit() {
 
     homekit_value_t new_value = HOMEKIT_UINT8(current_door_state);
     printf("Notifying homekit that current door state is now '%s'\n", state_description(current_door_state));
 
-    // Find the current door state characteristic c:
-    homekit_accessory_t *accessory = accessories[0];
-    homekit_service_t *service = accessory->services[1];
-    homekit_characteristic_t *c = service->characteristics[1];
-
-    assert(c);
+    homekit_characteristic_t *c = current_door_state_ch;
+    if (!c)
+        return;
 
     printf("Notifying changed '%s'\n", c->description);
     homekit_characteristic_notify(c, new_value);
@@ -170,12 +208,9 @@ void gdo_target_state_notify_homekit() {
     homekit_value_t new_value = gdo_target_state_get();
     printf("Notifying homekit that target door state is now '%s'\n", state_description(new_value.int_value));
 
-    // Find the target door state characteristic c:
-    homekit_accessory_t *accessory = accessories[0];
-    homekit_service_t *service = accessory->services[1];
-    homekit_characteristic_t *c = service->characteristics[2];
-
-    assert(c);
+    homekit_characteristic_t *c = target_door_state_ch;
+    if (!c)
+        return;
 
     printf("Notifying changed '%s'\n", c->description);
     homekit_characteristic_notify(c, new_value);
@@ -227,7 +262,7 @@ homekit_value_t gdo_target_state_get() {
 }
 
 /**
- * Called (indirectly) from the interrupt handler to notify the client of a state change.
+ * Called from the input worker task once the reed switch has settled on a new state.
  **/
 void contact_sensor_state_changed(uint8_t gpio, contact_sensor_state_t state) {
 
@@ -261,12 +296,9 @@ void gdo_target_state_set(homekit_value_t new_value) {
         return;
     }
 
-    // Toggle the garage door by toggling the relay connected to the GPIO (on - off):
-    // Turn ON GPIO:
+    // Toggle the garage door by pulsing the relay connected to the GPIO,
+    // actuator keeps it on for RELAY_PULSE_TIME:
     relay_write(true);
-    // Wait for some time:
-    vTaskDelay(400 / portTICK_PERIOD_MS);
-    // Turn OFF GPIO:
     relay_write(false);
     if (current_door_state == HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_CLOSED) {
         current_state_set(HOMEKIT_CHARACTERISTIC_CURRENT_DOOR_STATE_OPENING);
@@ -304,10 +336,13 @@ void user_init(void) {
 
 
     printf("Using Sensor at GPIO%d.\n", REED_PIN);
-    if (contact_sensor_create(REED_PIN, contact_sensor_state_changed)) {
+    contact_sensor_config_t sensor_config = CONTACT_SENSOR_CONFIG(
+        .settle_time = REED_SETTLE_TIME,
+    );
+    if (contact_sensor_create_ex(REED_PIN, &sensor_config, contact_sensor_state_changed)) {
         printf("Failed to initialize door\n");
     }
 
     homekit_server_init(&config);
-
+    gdo_characteristics_resolve();
 }
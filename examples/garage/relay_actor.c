@@ -1,9 +0,0 @@
-//
-//  relay_actor.c
-//  garage
-//
-//  Created by Dirk Theisen on 24.11.18.
-//  Copyright © 2018 Dirk Theisen. All rights reserved.
-//
-
-#include "relay_actor.h"
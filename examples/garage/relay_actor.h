@@ -1,14 +0,0 @@
-//
-//  relay_actor.h
-//  garage
-//
-//  Created by Dirk Theisen on 24.11.18.
-//  Copyright © 2018 Dirk Theisen. All rights reserved.
-//
-
-#ifndef relay_actor_h
-#define relay_actor_h
-
-#include <stdio.h>
-
-#endif /* relay_actor_h */
@@ -18,78 +18,143 @@
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <math.h>
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include "wifi.h"
 #include "ws2812_i2s/ws2812_i2s.h"
+#include <led_frame.h>
+#include <animation.h>
+#include <hsi_color.h>
+#include <dimming.h>
 
 #define LED_ON 0                // this is the value to write to GPIO for led on (0 = GPIO low)
 #define LED_INBUILT_GPIO 2      // this is the onboard LED used to show on/off only
 #define LED_COUNT 16            // this is the number of WS2812B leds on the strip
-#define LED_RGB_SCALE 255       // this is the scaling factor used for color conversion
-
-// Global variables
-float led_hue = 0;              // hue is scaled 0 to 360
-float led_saturation = 59;      // saturation is scaled 0 to 100
-float led_brightness = 100;     // brightness is scaled 0 to 100
-bool led_on = false;            // on is boolean on or off
-ws2812_pixel_t pixels[LED_COUNT];
-
-//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-static void hsi2rgb(float h, float s, float i, ws2812_pixel_t* rgb) {
-    int r, g, b;
-
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
+#define LED_REFRESH_PERIOD 10   // this is the minimum time between strip updates, in milliseconds
+#define LED_SETTLE_TIME 30      // this is the time to collect related changes before rendering, in milliseconds
+#define LED_GAMMA 2.2           // this is the brightness correction for each color channel, 1.0 for linear
+
+void led_update(homekit_characteristic_t *ch, homekit_value_t value, void *context);
+
+// Characteristics hold the state, server reads them without calling getters
+// and runs led_update() after a write. Hue is scaled 0 to 360, saturation
+// and brightness 0 to 100.
+homekit_characteristic_t led_on = HOMEKIT_CHARACTERISTIC_(
+    ON, false, .callback = HOMEKIT_CHARACTERISTIC_CALLBACK(led_update)
+);
+homekit_characteristic_t led_brightness = HOMEKIT_CHARACTERISTIC_(
+    BRIGHTNESS, 100, .callback = HOMEKIT_CHARACTERISTIC_CALLBACK(led_update)
+);
+homekit_characteristic_t led_hue = HOMEKIT_CHARACTERISTIC_(
+    HUE, 0, .callback = HOMEKIT_CHARACTERISTIC_CALLBACK(led_update)
+);
+homekit_characteristic_t led_saturation = HOMEKIT_CHARACTERISTIC_(
+    SATURATION, 59, .callback = HOMEKIT_CHARACTERISTIC_CALLBACK(led_update)
+);
+
+// State of the last render, writes of the same values do not render again
+bool led_rendered = false;
+bool led_rendered_on;
+float led_rendered_hue, led_rendered_saturation;
+int led_rendered_brightness;
+
+// Write coalescing: HomeKit writes hue, saturation and brightness in separate
+// requests, so renders are deferred until the settle time passes. Render
+// runs in animation task, which already owns frame and animation locks.
+animation_t led_apply_animation;
+bool led_apply_pending = false;
+uint32_t led_renders_requested = 0;
+uint32_t led_renders_performed = 0;
+
+const hsi_color_config_t led_color_config = {
+    .depth = 16,
+    .intensity = hsi_color_intensity_linear,
+};
 
-    rgb->red = (uint8_t) r;
-    rgb->green = (uint8_t) g;
-    rgb->blue = (uint8_t) b;
-    rgb->white = (uint8_t) 0;           // white channel is not used
-}
+// Colors are computed with 16 bits per channel, strip has 8 bits, so at
+// low levels color between two strip levels is dithered over frames, as
+// far as refresh rate allows without flicker. Otherwise it is rounded and
+// strip is not rendered until the color changes.
+dimming_t led_dimming;
+uint8_t led_dither_bits;
+dimming_dither_t led_dither[3];
+uint16_t led_duty[3];
 
 void led_string_fill(ws2812_pixel_t rgb) {
+    // write out the new color to each pixel, strip is only updated if color has changed
+    led_frame_fill(rgb);
+}
 
-    // write out the new color to each pixel
-    for (int i = 0; i < LED_COUNT; i++) {
-        pixels[i] = rgb;
-    }
-    ws2812_i2s_update(pixels, PIXEL_RGB);
+// Identify blinks the strip three times in three groups
+const animation_keyframe_t led_identify_keyframes[] = {
+    { 1, 100 }, { 0, 100 },
+    { 1, 100 }, { 0, 100 },
+    { 1, 100 }, { 0, 350 },
+};
+animation_sequence_t led_identify_animation;
+
+int led_dither_step(animation_t *animation) {
+    ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
+    rgb.red = dimming_dither8(&led_dither[0], led_duty[0]);
+    rgb.green = dimming_dither8(&led_dither[1], led_duty[1]);
+    rgb.blue = dimming_dither8(&led_dither[2], led_duty[2]);
+
+    led_string_fill(rgb);
+
+    return LED_REFRESH_PERIOD;
+}
+
+animation_t led_dither_animation = {
+    .step = led_dither_step,
+};
+
+bool led_string_changed(void) {
+    return !led_rendered ||
+        led_rendered_on != led_on.value.bool_value ||
+        led_rendered_hue != led_hue.value.float_value ||
+        led_rendered_saturation != led_saturation.value.float_value ||
+        led_rendered_brightness != led_brightness.value.int_value;
 }
 
 void led_string_set(void) {
     ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
 
-    if (led_on) {
-        // convert HSI to RGBW
-        hsi2rgb(led_hue, led_saturation, led_brightness, &rgb);
-        //printf("h=%d,s=%d,b=%d => ", (int)led_hue, (int)led_saturation, (int)led_brightness);
+    // identify restores the state when it finishes
+    if (animation_is_active(&led_identify_animation.animation))
+        return;
+
+    led_rendered = true;
+    led_rendered_on = led_on.value.bool_value;
+    led_rendered_hue = led_hue.value.float_value;
+    led_rendered_saturation = led_saturation.value.float_value;
+    led_rendered_brightness = led_brightness.value.int_value;
+
+    if (led_rendered_on) {
+        // convert HSI to RGB
+        hsi_color_t color;
+        hsi2rgb(&led_color_config, led_rendered_hue, led_rendered_saturation, led_rendered_brightness, &color);
+
+        animation_lock();
+        led_duty[0] = dimming_round8(dimming_apply(&led_dimming, color.red), led_dither_bits);
+        led_duty[1] = dimming_round8(dimming_apply(&led_dimming, color.green), led_dither_bits);
+        led_duty[2] = dimming_round8(dimming_apply(&led_dimming, color.blue), led_dither_bits);
+
+        if (dimming_needs_dither8(led_duty[0]) ||
+                dimming_needs_dither8(led_duty[1]) ||
+                dimming_needs_dither8(led_duty[2])) {
+            if (!animation_is_active(&led_dither_animation))
+                animation_start(&led_dither_animation);
+            animation_unlock();
+            gpio_write(LED_INBUILT_GPIO, LED_ON);
+            return;
+        }
+        animation_unlock();
+
+        rgb.red = led_duty[0] >> 8;
+        rgb.green = led_duty[1] >> 8;
+        rgb.blue = led_duty[2] >> 8;
+        //printf("h=%d,s=%d,b=%d => ", (int)led_rendered_hue, (int)led_rendered_saturation, led_rendered_brightness);
         //printf("r=%d,g=%d,b=%d,w=%d\n", rgbw.red, rgbw.green, rgbw.blue, rgbw.white);
 
         // set the inbuilt led
@@ -101,9 +166,46 @@ void led_string_set(void) {
     }
 
     // write out the new color 
+    animation_stop(&led_dither_animation);
     led_string_fill(rgb);
 }
 
+// led_apply_pending is shared by HomeKit task and animation task. Pending
+// flag is cleared before rendering, so a request made while rendering
+// either is covered by it or starts the animation again once this frame
+// has finished.
+static int led_apply_step(animation_t *animation) {
+    // first frame only waits for related changes
+    if (animation->frame == 0)
+        return LED_SETTLE_TIME;
+
+    taskENTER_CRITICAL();
+    led_apply_pending = false;
+    led_renders_performed++;
+    taskEXIT_CRITICAL();
+
+    led_string_set();
+    return ANIMATION_DONE;
+}
+
+void led_string_request(void) {
+    taskENTER_CRITICAL();
+    if (!led_apply_pending && !led_string_changed()) {
+        taskEXIT_CRITICAL();
+        return;
+    }
+
+    led_renders_requested++;
+
+    // window starts with the first change so continuous writes still render
+    bool start = !led_apply_pending;
+    led_apply_pending = true;
+    taskEXIT_CRITICAL();
+
+    if (start)
+        animation_start(&led_apply_animation);
+}
+
 static void wifi_init() {
     struct sdk_station_config wifi_config = {
         .ssid = WIFI_SSID,
@@ -115,92 +217,55 @@ static void wifi_init() {
     sdk_wifi_station_connect();
 }
 
-void led_init() {
-    // initialise the onboard led as a secondary indicator (handy for testing)
-    gpio_enable(LED_INBUILT_GPIO, GPIO_OUTPUT);
-
-    // initialise the LED strip
-    ws2812_i2s_init(LED_COUNT, PIXEL_RGB);
-
-    // set the initial state
-    led_string_set();
-}
-
-void led_identify_task(void *_args) {
+void led_identify_apply(uint32_t value, void *context) {
     const ws2812_pixel_t COLOR_PINK = { { 255, 0, 127, 0 } };
     const ws2812_pixel_t COLOR_BLACK = { { 0, 0, 0, 0 } };
 
-    for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 3; j++) {
-            gpio_write(LED_INBUILT_GPIO, LED_ON);
-            led_string_fill(COLOR_PINK);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            gpio_write(LED_INBUILT_GPIO, 1 - LED_ON);
-            led_string_fill(COLOR_BLACK);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-        }
-        vTaskDelay(250 / portTICK_PERIOD_MS);
-    }
-
-    led_string_set();
-    vTaskDelete(NULL);
-}
-
-void led_identify(homekit_value_t _value) {
-    // printf("LED identify\n");
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
+    gpio_write(LED_INBUILT_GPIO, value ? LED_ON : 1 - LED_ON);
+    led_string_fill(value ? COLOR_PINK : COLOR_BLACK);
 }
 
-homekit_value_t led_on_get() {
-    return HOMEKIT_BOOL(led_on);
+void led_identify_finish(animation_t *animation) {
+    led_string_set();
 }
 
-void led_on_set(homekit_value_t value) {
-    if (value.format != homekit_format_bool) {
-        // printf("Invalid on-value format: %d\n", value.format);
-        return;
-    }
+void led_init() {
+    // initialise the onboard led as a secondary indicator (handy for testing)
+    gpio_enable(LED_INBUILT_GPIO, GPIO_OUTPUT);
 
-    led_on = value.bool_value;
-    led_string_set();
-}
+    // initialise the LED strip
+    led_frame_init(LED_COUNT, PIXEL_RGB, LED_REFRESH_PERIOD);
 
-homekit_value_t led_brightness_get() {
-    return HOMEKIT_INT(led_brightness);
-}
-void led_brightness_set(homekit_value_t value) {
-    if (value.format != homekit_format_int) {
-        // printf("Invalid brightness-value format: %d\n", value.format);
-        return;
-    }
-    led_brightness = value.int_value;
-    led_string_set();
-}
+    // separate group, so identify does not pause it
+    led_apply_animation.step = led_apply_step;
+    led_apply_animation.group = 1;
 
-homekit_value_t led_hue_get() {
-    return HOMEKIT_FLOAT(led_hue);
-}
+    dimming_config_t dimming_config = {
+        .gamma = LED_GAMMA,
+    };
+    dimming_init(&led_dimming, &dimming_config);
+    led_dither_bits = dimming_dither_bits(LED_REFRESH_PERIOD);
+
+    animation_init();
+    animation_sequence_init(&led_identify_animation,
+                            led_identify_keyframes,
+                            sizeof(led_identify_keyframes) / sizeof(*led_identify_keyframes),
+                            3, led_identify_apply, NULL);
+    // identify pauses dithering while it runs
+    led_identify_animation.animation.priority = 1;
+    led_identify_animation.animation.on_finish = led_identify_finish;
 
-void led_hue_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        // printf("Invalid hue-value format: %d\n", value.format);
-        return;
-    }
-    led_hue = value.float_value;
+    // set the initial state
     led_string_set();
 }
 
-homekit_value_t led_saturation_get() {
-    return HOMEKIT_FLOAT(led_saturation);
+void led_identify(homekit_value_t _value) {
+    // printf("LED identify\n");
+    animation_start(&led_identify_animation.animation);
 }
 
-void led_saturation_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        // printf("Invalid sat-value format: %d\n", value.format);
-        return;
-    }
-    led_saturation = value.float_value;
-    led_string_set();
+void led_update(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
+    led_string_request();
 }
 
 homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "Sample LED Strip");
@@ -218,26 +283,10 @@ homekit_accessory_t *accessories[] = {
         }),
         HOMEKIT_SERVICE(LIGHTBULB, .primary = true, .characteristics = (homekit_characteristic_t*[]) {
             HOMEKIT_CHARACTERISTIC(NAME, "Sample LED Strip"),
-            HOMEKIT_CHARACTERISTIC(
-                ON, true,
-                .getter = led_on_get,
-                .setter = led_on_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                BRIGHTNESS, 100,
-                .getter = led_brightness_get,
-                .setter = led_brightness_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                HUE, 0,
-                .getter = led_hue_get,
-                .setter = led_hue_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                SATURATION, 0,
-                .getter = led_saturation_get,
-                .setter = led_saturation_set
-            ),
+            &led_on,
+            &led_brightness,
+            &led_hue,
+            &led_saturation,
             NULL
         }),
         NULL
@@ -26,8 +26,8 @@
 #include "wifi.h"
 
 #include "WS2812FX/WS2812FX.h"
+#include <hsi_color.h>
 
-#define LED_RGB_SCALE 255       // this is the scaling factor used for color conversion
 #define LED_COUNT 50            // this is the number of WS2812B leds on the strip
 #define LED_INBUILT_GPIO 2      // this is the onboard LED used to show on/off only
 
@@ -43,41 +43,16 @@ float fx_saturation = 50;      // saturation is scaled 0 to 100
 float fx_brightness = 50;     // brightness is scaled 0 to 100
 bool fx_on = true;
 
-//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-static void hsi2rgb(float h, float s, float i, ws2812_pixel_t* rgb) {
-    int r, g, b;
-
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
+const hsi_color_config_t led_color_config = {
+    .depth = 8,
+    .intensity = hsi_color_intensity_shaped,
+};
+
+static void led_color_set() {
+    hsi_color_t color;
+    hsi2rgb(&led_color_config, led_hue, led_saturation, 100, &color);
 
-    rgb->red = (uint8_t) r;
-    rgb->green = (uint8_t) g;
-    rgb->blue = (uint8_t) b;
-    rgb->white = (uint8_t) 0;           // white channel is not used
+    WS2812FX_setColor(color.red, color.green, color.blue);
 }
 
 static void wifi_init() {
@@ -160,11 +135,8 @@ void led_hue_set(homekit_value_t value) {
         return;
     }
     led_hue = value.float_value;
-    
-    ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
-    hsi2rgb(led_hue, led_saturation, 100, &rgb);
-    
-    WS2812FX_setColor(rgb.red, rgb.green, rgb.blue);
+
+    led_color_set();
 }
 
 homekit_value_t led_saturation_get() {
@@ -177,11 +149,8 @@ void led_saturation_set(homekit_value_t value) {
         return;
     }
     led_saturation = value.float_value;
-    
-    ws2812_pixel_t rgb = { { 0, 0, 0, 0 } };
-    hsi2rgb(led_hue, led_saturation, 100, &rgb);
-    
-    WS2812FX_setColor(rgb.red, rgb.green, rgb.blue);
+
+    led_color_set();
 }
 
 homekit_value_t fx_on_get() {
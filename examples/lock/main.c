@@ -19,7 +19,8 @@
 #include <homekit/characteristics.h>
 #include <wifi_config.h>
 
-#include "button.h"
+#include <gpio_button.h>
+#include <actuator.h>
 
 // The GPIO pin that is connected to a relay
 const int relay_gpio = 12;
@@ -38,8 +39,10 @@ const int relay_open_signal = 1;
 void lock_lock();
 void lock_unlock();
 
-void relay_write(int value) {
-    gpio_write(relay_gpio, value ? 1 : 0);
+int relay_channel = -1;
+
+void relay_write(bool open) {
+    actuator_set(relay_channel, open);
 }
 
 void led_write(bool on) {
@@ -83,17 +86,24 @@ void gpio_init() {
     gpio_enable(led_gpio, GPIO_OUTPUT);
     led_write(false);
 
-    gpio_enable(relay_gpio, GPIO_OUTPUT);
-    relay_write(!relay_open_signal);
+    actuator_config_t relay_config = {
+        .name = "Lock",
+        .gpio = relay_gpio,
+        .active_low = !relay_open_signal,
+    };
+    relay_channel = actuator_add(&relay_config);
+    if (relay_channel < 0) {
+        printf("Failed to initialize relay\n");
+    }
 }
 
-void button_callback(uint8_t gpio, button_event_t event) {
+void button_callback(uint8_t gpio, gpio_button_event_t event) {
     switch (event) {
-        case button_event_single_press:
+        case gpio_button_event_single_press:
             printf("Toggling relay\n");
             lock_unlock();
             break;
-        case button_event_long_press:
+        case gpio_button_event_long_press:
             reset_configuration();
             break;
         default:
@@ -169,7 +179,7 @@ ETSTimer lock_timer;
 void lock_lock() {
     sdk_os_timer_disarm(&lock_timer);
 
-    relay_write(!relay_open_signal);
+    relay_write(false);
     led_write(false);
 
     if (lock_current_state.value.int_value != lock_state_secured) {
@@ -196,7 +206,7 @@ void lock_init() {
 }
 
 void lock_unlock() {
-    relay_write(relay_open_signal);
+    relay_write(true);
     led_write(true);
 
     lock_current_state.value = HOMEKIT_UINT8(lock_state_unsecured);
@@ -268,7 +278,7 @@ void user_init(void) {
     gpio_init();
     lock_init();
 
-    if (button_create(button_gpio, 0, 4000, button_callback)) {
+    if (gpio_button_create(button_gpio, 0, 4000, button_callback)) {
         printf("Failed to initialize button\n");
     }
 }
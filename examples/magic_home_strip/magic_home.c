@@ -11,27 +11,35 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <espressif/esp_wifi.h>
 #include <espressif/esp_sta.h>
 #include <esp/uart.h>
 #include <esp8266.h>
 #include <FreeRTOS.h>
 #include <task.h>
-#include <math.h> 
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
 #include <wifi_config.h>
 
 #include "multipwm.h"
+#include <hsi_color.h>
+#include <animation.h>
+#include <transition.h>
+#include <dimming.h>
 
-#define LPF_SHIFT 4  // divide by 16
-#define LPF_INTERVAL 10  // in milliseconds
+// Color transitions, see transition_easing_t for available easings
+#define LED_TRANSITION_EASING transition_easing_ease_in_out
+#define LED_TRANSITION_DURATION 400  // in milliseconds
+#define LED_TRANSITION_INTERVAL 20  // in milliseconds
+#define LED_TRANSITION_LPF_SHIFT 4  // divide by 16, for transition_easing_lpf
+
+#define LED_GAMMA 2.2  // channel brightness correction, 1.0 for linear
 
 #define RED_PWM_PIN 5
 #define GREEN_PWM_PIN 12
 #define BLUE_PWM_PIN 13
-#define LED_RGB_SCALE 255       // this is the scaling factor used for color conversion
 
 typedef union {
     struct {
@@ -43,127 +51,119 @@ typedef union {
     uint64_t color;
 } rgb_color_t;
 
-// Color smoothing variables
-rgb_color_t current_color = { { 0, 0, 0, 0 } };
-rgb_color_t target_color = { { 0, 0, 0, 0 } };
-
-// Global variables
-float led_hue = 0;              // hue is scaled 0 to 360
-float led_saturation = 59;      // saturation is scaled 0 to 100
-float led_brightness = 100;     // brightness is scaled 0 to 100
-bool led_on = false;            // on is boolean on or off
-
-//http://blog.saikoled.com/post/44677718712/how-to-convert-from-hsi-to-rgb-white
-static void hsi2rgb(float h, float s, float i, rgb_color_t* rgb) {
-    int r, g, b;
-
-    while (h < 0) { h += 360.0F; };     // cycle h around to 0-360 degrees
-    while (h >= 360) { h -= 360.0F; };
-    h = 3.14159F*h / 180.0F;            // convert to radians.
-    s /= 100.0F;                        // from percentage to ratio
-    i /= 100.0F;                        // from percentage to ratio
-    s = s > 0 ? (s < 1 ? s : 1) : 0;    // clamp s and i to interval [0,1]
-    i = i > 0 ? (i < 1 ? i : 1) : 0;    // clamp s and i to interval [0,1]
-    //i = i * sqrt(i);                    // shape intensity to have finer granularity near 0
-
-    if (h < 2.09439) {
-        r = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        g = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        b = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else if (h < 4.188787) {
-        h = h - 2.09439;
-        g = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        b = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        r = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
-    else {
-        h = h - 4.188787;
-        b = LED_RGB_SCALE * i / 3 * (1 + s * cos(h) / cos(1.047196667 - h));
-        r = LED_RGB_SCALE * i / 3 * (1 + s * (1 - cos(h) / cos(1.047196667 - h)));
-        g = LED_RGB_SCALE * i / 3 * (1 - s);
-    }
+// Color smoothing
+transition_t led_transition;
+dimming_t led_dimming;
+pwm_info_t pwm_info;
+uint16_t pwm_duty[3] = { 0, 0, 0 };
+
+// Target of the running transition
+rgb_color_t led_target = { { 0, 0, 0, 0 } };
+
+void led_update(homekit_characteristic_t *ch, homekit_value_t value, void *context);
+
+// Characteristics hold the state, server reads them without calling getters
+// and runs led_update() after a write. Hue is scaled 0 to 360, saturation
+// and brightness 0 to 100.
+homekit_characteristic_t led_on = HOMEKIT_CHARACTERISTIC_(
+    ON, false, .callback = HOMEKIT_CHARACTERISTIC_CALLBACK(led_update)
+);
+homekit_characteristic_t led_brightness = HOMEKIT_CHARACTERISTIC_(
+    BRIGHTNESS, 100, .callback = HOMEKIT_CHARACTERISTIC_CALLBACK(led_update)
+);
+homekit_characteristic_t led_hue = HOMEKIT_CHARACTERISTIC_(
+    HUE, 0, .callback = HOMEKIT_CHARACTERISTIC_CALLBACK(led_update)
+);
+homekit_characteristic_t led_saturation = HOMEKIT_CHARACTERISTIC_(
+    SATURATION, 59, .callback = HOMEKIT_CHARACTERISTIC_CALLBACK(led_update)
+);
+
+const hsi_color_config_t led_color_config = {
+    .depth = 16,
+    .intensity = hsi_color_intensity_linear,
+};
 
-    rgb->red = (uint8_t) r;
-    rgb->green = (uint8_t) g;
-    rgb->blue = (uint8_t) b;
+static void led_color_get(rgb_color_t* rgb) {
+    hsi_color_t color;
+    hsi2rgb(&led_color_config,
+            led_hue.value.float_value, led_saturation.value.float_value, led_brightness.value.int_value,
+            &color);
+
+    rgb->red = color.red;
+    rgb->green = color.green;
+    rgb->blue = color.blue;
 }
 
-void led_identify_task(void *_args) {
-    printf("LED identify\n");
-    
-    rgb_color_t color = target_color;
-    rgb_color_t black_color = { { 0, 0, 0, 0 } };
-    rgb_color_t white_color = { { 128, 128, 128, 128 } };
-    
-    for (int i=0; i<3; i++) {
-        for (int j=0; j<2; j++) {
-            target_color = white_color;
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-            
-            target_color = black_color;
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-        }
-
-        vTaskDelay(250 / portTICK_PERIOD_MS);
-    }
+// Identify blinks white twice in three groups
+const animation_keyframe_t led_identify_keyframes[] = {
+    { 1, 100 }, { 0, 100 },
+    { 1, 100 }, { 0, 350 },
+};
+animation_sequence_t led_identify_animation;
 
-    target_color = color;
+static void led_transition_set(rgb_color_t *color) {
+    led_target = *color;
 
-    vTaskDelete(NULL);
+    uint16_t values[3] = { color->red, color->green, color->blue };
+    transition_set(&led_transition, values);
 }
 
-void led_identify(homekit_value_t _value) {
-    xTaskCreate(led_identify_task, "LED identify", 128, NULL, 2, NULL);
-}
+void led_color_update() {
+    // identify restores the color when it finishes
+    if (animation_is_active(&led_identify_animation.animation))
+        return;
 
-homekit_value_t led_on_get() {
-    return HOMEKIT_BOOL(led_on);
-}
+    rgb_color_t color = { { 0, 0, 0, 0 } };
+    if (led_on.value.bool_value) {
+        // convert HSI to RGB
+        led_color_get(&color);
+    }
 
-void led_on_set(homekit_value_t value) {
-    if (value.format != homekit_format_bool) {
-        // printf("Invalid on-value format: %d\n", value.format);
+    // Writes that do not change the color do not restart transition
+    if (color.color == led_target.color)
         return;
-    }
 
-    led_on = value.bool_value;
+    led_transition_set(&color);
 }
 
-homekit_value_t led_brightness_get() {
-    return HOMEKIT_INT(led_brightness);
-}
+void led_pwm_apply(const uint16_t *values, void *context) {
+    // Transition runs on linear values, gamma is applied to the output
+    uint16_t duty[3];
+    for (uint8_t i=0; i<3; i++) {
+        duty[i] = dimming_apply(&led_dimming, values[i]);
+    }
 
-void led_brightness_set(homekit_value_t value) {
-    if (value.format != homekit_format_int) {
-        // printf("Invalid brightness-value format: %d\n", value.format);
+    // Restarting PWM causes a glitch, so skip it if duties are the same
+    if (!memcmp(pwm_duty, duty, sizeof(pwm_duty)))
         return;
+
+    memcpy(pwm_duty, duty, sizeof(pwm_duty));
+
+    multipwm_stop(&pwm_info);
+    for (uint8_t i=0; i<pwm_info.channels; i++) {
+        multipwm_set_duty(&pwm_info, i, pwm_duty[i]);
     }
-    led_brightness = value.int_value;
+    multipwm_start(&pwm_info);
 }
 
-homekit_value_t led_hue_get() {
-    return HOMEKIT_FLOAT(led_hue);
+void led_identify_apply(uint32_t value, void *context) {
+    rgb_color_t black_color = { { 0, 0, 0, 0 } };
+    rgb_color_t white_color = { { 32768, 32768, 32768, 32768 } };
+
+    led_transition_set(value ? &white_color : &black_color);
 }
 
-void led_hue_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        // printf("Invalid hue-value format: %d\n", value.format);
-        return;
-    }
-    led_hue = value.float_value;
+void led_identify_finish(animation_t *animation) {
+    led_color_update();
 }
 
-homekit_value_t led_saturation_get() {
-    return HOMEKIT_FLOAT(led_saturation);
+void led_identify(homekit_value_t _value) {
+    printf("LED identify\n");
+    animation_start(&led_identify_animation.animation);
 }
 
-void led_saturation_set(homekit_value_t value) {
-    if (value.format != homekit_format_float) {
-        // printf("Invalid sat-value format: %d\n", value.format);
-        return;
-    }
-    led_saturation = value.float_value;
+void led_update(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
+    led_color_update();
 }
 
 homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "LED Strip");
@@ -181,26 +181,10 @@ homekit_accessory_t *accessories[] = {
         }),
         HOMEKIT_SERVICE(LIGHTBULB, .primary = true, .characteristics = (homekit_characteristic_t*[]) {
             HOMEKIT_CHARACTERISTIC(NAME, "LED Strip"),
-            HOMEKIT_CHARACTERISTIC(
-                ON, true,
-                .getter = led_on_get,
-                .setter = led_on_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                BRIGHTNESS, 100,
-                .getter = led_brightness_get,
-                .setter = led_brightness_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                HUE, 0,
-                .getter = led_hue_get,
-                .setter = led_hue_set
-            ),
-            HOMEKIT_CHARACTERISTIC(
-                SATURATION, 0,
-                .getter = led_saturation_get,
-                .setter = led_saturation_set
-            ),
+            &led_on,
+            &led_brightness,
+            &led_hue,
+            &led_saturation,
             NULL
         }),
         NULL
@@ -213,13 +197,9 @@ homekit_server_config_t config = {
     .password = "190-11-978"    //changed tobe valid
 };
 
-IRAM void multipwm_task(void *pvParameters) {
-    const TickType_t xPeriod = pdMS_TO_TICKS(LPF_INTERVAL);
-    TickType_t xLastWakeTime = xTaskGetTickCount();
-    
+void led_init() {
     uint8_t pins[] = {RED_PWM_PIN, GREEN_PWM_PIN, BLUE_PWM_PIN};
 
-    pwm_info_t pwm_info;
     pwm_info.channels = 3;
 
     multipwm_init(&pwm_info);
@@ -228,28 +208,32 @@ IRAM void multipwm_task(void *pvParameters) {
         multipwm_set_pin(&pwm_info, i, pins[i]);
     }
 
-    while(1) {
-        if (led_on) {
-            // convert HSI to RGBW
-            hsi2rgb(led_hue, led_saturation, led_brightness, &target_color);
-        } else {
-            target_color.red = 0;
-            target_color.green = 0;
-            target_color.blue = 0;
-        }
-        
-        current_color.red += ((target_color.red * 256) - current_color.red) >> LPF_SHIFT ;
-        current_color.green += ((target_color.green * 256) - current_color.green) >> LPF_SHIFT ;
-        current_color.blue += ((target_color.blue * 256) - current_color.blue) >> LPF_SHIFT ;
-        
-        multipwm_stop(&pwm_info);
-        multipwm_set_duty(&pwm_info, 0, current_color.red);
-        multipwm_set_duty(&pwm_info, 1, current_color.green);
-        multipwm_set_duty(&pwm_info, 2, current_color.blue);
-        multipwm_start(&pwm_info);
-                
-        vTaskDelayUntil(&xLastWakeTime, xPeriod);
-    }
+    dimming_config_t dimming_config = {
+        .gamma = LED_GAMMA,
+    };
+    dimming_init(&led_dimming, &dimming_config);
+
+    animation_init();
+
+    transition_config_t transition_config = {
+        .easing = LED_TRANSITION_EASING,
+        .duration = LED_TRANSITION_DURATION,
+        .interval = LED_TRANSITION_INTERVAL,
+        .lpf_shift = LED_TRANSITION_LPF_SHIFT,
+        .channels = 3,
+        .apply = led_pwm_apply,
+    };
+    transition_init(&led_transition, &transition_config);
+
+    // Identify runs in its own group so it does not pause color transition
+    animation_sequence_init(&led_identify_animation,
+                            led_identify_keyframes,
+                            sizeof(led_identify_keyframes) / sizeof(*led_identify_keyframes),
+                            3, led_identify_apply, NULL);
+    led_identify_animation.animation.group = 1;
+    led_identify_animation.animation.on_finish = led_identify_finish;
+
+    led_color_update();
 }
 
 void on_wifi_ready() {
@@ -271,5 +255,5 @@ void user_init(void) {
 
     wifi_config_init("MagicHome Led Strip", NULL, on_wifi_ready);
     
-    xTaskCreate(multipwm_task, "multipwm", 256, NULL, 2, NULL);
+    led_init();
 }
@@ -36,8 +36,8 @@ modified to do pulse-width-modulation (PWM) of LED
 #include <wifi_config.h>
 #include "wifi.h"
 
-#include "button.h"
-#include "toggle.h"
+#include <gpio_button.h>
+#include <gpio_toggle.h>
 
 // The GPIO pin that is connected to the relay on the Sonoff Basic.
 const int relay_gpio = 12;
@@ -49,9 +49,17 @@ const int button_gpio = 0;
 const int toggle_gpio = 14;
 
 #include <pwm.h>
+#include <dimming.h>
 // The PWM pin that is connected to the PWM daughter board.
 const int pwm_gpio = 13;
 
+// Brightness curve: perceived brightness is roughly duty ^ (1 / 2.2)
+#define LIGHT_GAMMA 2.2
+// Lowest duty at which the lamp is still visibly on
+#define LIGHT_MIN_ON 256
+
+dimming_t dimming;
+
 const bool dev = true;
 
 float bri;
@@ -112,7 +120,7 @@ void gpio_init() {
 void lightSET_task(void *pvParameters) {
     int w;
     if (on) {
-        w = (UINT16_MAX - UINT16_MAX*bri/100);
+        w = UINT16_MAX - dimming_apply(&dimming, dimming_level(bri));
         pwm_set_duty(w);
         printf("ON  %3d [%5d]\n", (int)bri , w);
     } else {
@@ -133,6 +141,11 @@ void light_init() {
     on=false;
     bri=100;
     printf("on = false  bri = 100 %%\n");
+    dimming_config_t dimming_config = {
+        .gamma = LIGHT_GAMMA,
+        .min_on = LIGHT_MIN_ON,
+    };
+    dimming_init(&dimming, &dimming_config);
     pwm_set_freq(1000);
     printf("PWMpwm_set_freq = 1000 Hz  pwm_set_duty = 0 = 0%%\n");
     pwm_set_duty(UINT16_MAX);
@@ -200,16 +213,16 @@ homekit_characteristic_t name = HOMEKIT_CHARACTERISTIC_(NAME, "Sonoff Dimmer");
 homekit_characteristic_t lightbulb_on = HOMEKIT_CHARACTERISTIC_(ON, false, .getter=light_on_get, .setter=light_on_set);
 
 
-void button_callback(uint8_t gpio, button_event_t event) {
+void button_callback(uint8_t gpio, gpio_button_event_t event) {
     switch (event) {
-        case button_event_single_press:
+        case gpio_button_event_single_press:
             printf("Toggling lightbulb due to button at GPIO %2d\n", gpio);
             lightbulb_on.value.bool_value = !lightbulb_on.value.bool_value;
             on = lightbulb_on.value.bool_value;
             lightSET();
             homekit_characteristic_notify(&lightbulb_on, lightbulb_on.value);
             break;
-        case button_event_long_press:
+        case gpio_button_event_long_press:
             printf("Reseting WiFi configuration!\n");
             reset_configuration();
             break;
@@ -293,10 +306,10 @@ void user_init(void) {
     gpio_init();
     light_init();
 
-    if (button_create(button_gpio, 0, 4000, button_callback)) {
+    if (gpio_button_create(button_gpio, 0, 4000, button_callback)) {
         printf("Failed to initialize button\n");
     }
-    if (toggle_create(toggle_gpio, toggle_callback)) {
+    if (gpio_toggle_create(toggle_gpio, toggle_callback)) {
         printf("Failed to initialize toggle\n");
     }
 }
@@ -4,6 +4,13 @@
  * Copyright (C) 2015 Guillem Pascual Ginovart (https://github.com/gpascualg)
  * Copyright (C) 2015 Javier Cardona (https://github.com/jcard0na)
  * BSD Licensed as described in the file LICENSE
+ *
+ * Each channel has its own duty. Every period starts with all active
+ * channels on, then channels are turned off in order of their duty.
+ * Channels that turn off at the same time share one timer interrupt.
+ *
+ * Duty changes are written to a shadow schedule, which interrupt handler
+ * picks up at the start of next period, so pwm never has to be restarted.
  */
 #include "pwm.h"
 
@@ -18,60 +25,184 @@
 #define debug(fmt, ...)
 #endif
 
+/* Edges closer than this (in timer ticks) are merged, interrupt
+   handler can not reliably reload timer with smaller values */
+#define PWM_MIN_LOAD 16
+
 typedef struct PWMPinDefinition
 {
     uint8_t pin;
-    uint8_t divider;
+    uint16_t duty;
 } PWMPin;
 
-typedef enum {
-    PERIOD_ON   = 0,
-    PERIOD_OFF  = 1
-} pwm_step_t;
+typedef struct PWMStepDefinition
+{
+    /* Timer ticks until next step */
+    uint32_t load;
+    uint16_t setMask;
+    uint16_t clearMask;
+} PWMStep;
 
+typedef struct PWMScheduleDefinition
+{
+    uint8_t count;
+    PWMStep steps[MAX_PWM_PINS + 1];
+} PWMSchedule;
 
 typedef struct pwmInfoDefinition
 {
     uint8_t running;
-    bool output;
     bool reverse;
 
     uint16_t freq;
-    uint16_t dutyCycle;
 
     /* private */
     uint32_t _maxLoad;
-    uint32_t _onLoad;
-    uint32_t _offLoad;
-    pwm_step_t _step;
+    uint16_t _pinMask;
+
+    /* Schedule used by interrupt handler and a shadow copy */
+    PWMSchedule _schedules[2];
+    volatile uint8_t _active;
+    volatile bool _pending;
+    volatile bool _timerRunning;
+    uint8_t _step;
 
     uint16_t usedPins;
-    PWMPin pins[8];
+    PWMPin pins[MAX_PWM_PINS];
 } PWMInfo;
 
 static PWMInfo pwmInfo;
 
 static void IRAM frc1_interrupt_handler(void *arg)
 {
-    uint8_t i = 0;
-    bool out = true;
-    uint32_t load = pwmInfo._onLoad;
-    pwm_step_t step = PERIOD_ON;
+    /* Switch to new schedule only at period boundary */
+    if (pwmInfo._step == 0 && pwmInfo._pending)
+    {
+        pwmInfo._active ^= 1;
+        pwmInfo._pending = false;
+    }
+
+    const PWMSchedule *schedule = &pwmInfo._schedules[pwmInfo._active];
+    const PWMStep *step = &schedule->steps[pwmInfo._step];
+
+    GPIO.OUT_SET = step->setMask;
+    GPIO.OUT_CLEAR = step->clearMask;
+
+    if (schedule->count == 1)
+    {
+        /* Constant output, no need for interrupts */
+        timer_set_interrupts(FRC1, false);
+        timer_set_run(FRC1, false);
+        pwmInfo._timerRunning = false;
+        return;
+    }
+
+    timer_set_load(FRC1, step->load);
+
+    pwmInfo._step++;
+    if (pwmInfo._step == schedule->count)
+        pwmInfo._step = 0;
+}
+
+static void pwm_build_schedule(PWMSchedule *schedule)
+{
+    uint32_t times[MAX_PWM_PINS];
+    uint16_t masks[MAX_PWM_PINS];
+    uint8_t count = 0;
+
+    uint16_t onMask = 0;
+    uint16_t offMask = 0;
 
-    if (pwmInfo._step == PERIOD_ON)
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
     {
-        out = false;
-        load = pwmInfo._offLoad;
-        step = PERIOD_OFF;
+        uint16_t mask = BIT(pwmInfo.pins[i].pin);
+        uint32_t load = pwmInfo.pins[i].duty * pwmInfo._maxLoad / UINT16_MAX;
+
+        // 0% and 100% duty cycle are special cases: constant output.
+        // Duties too close to them to be timed are rounded.
+        if (load < PWM_MIN_LOAD)
+        {
+            offMask |= mask;
+            continue;
+        }
+
+        onMask |= mask;
+        if (pwmInfo.pins[i].duty == UINT16_MAX || load + PWM_MIN_LOAD > pwmInfo._maxLoad)
+            continue;
+
+        /* Insert edge in order, merging it with edges close to it */
+        uint8_t j = 0;
+        while (j < count && times[j] + PWM_MIN_LOAD <= load)
+            j++;
+
+        if (j < count && times[j] < load + PWM_MIN_LOAD)
+        {
+            masks[j] |= mask;
+            continue;
+        }
+
+        for (uint8_t k = count; k > j; k--)
+        {
+            times[k] = times[k-1];
+            masks[k] = masks[k-1];
+        }
+        times[j] = load;
+        masks[j] = mask;
+        count++;
     }
 
-    for (; i < pwmInfo.usedPins; ++i)
+    schedule->count = count + 1;
+
+    schedule->steps[0].setMask = onMask;
+    schedule->steps[0].clearMask = offMask;
+    schedule->steps[0].load = count ? times[0] : pwmInfo._maxLoad;
+
+    for (uint8_t j = 0; j < count; j++)
     {
-         gpio_write(pwmInfo.pins[i].pin, pwmInfo.reverse ? !out : out);
+        PWMStep *step = &schedule->steps[j + 1];
+        step->setMask = 0;
+        step->clearMask = masks[j];
+        step->load = ((j + 1 < count) ? times[j + 1] : pwmInfo._maxLoad) - times[j];
     }
 
-    timer_set_load(FRC1, load);
-    pwmInfo._step = step;
+    if (pwmInfo.reverse)
+    {
+        for (uint8_t j = 0; j < schedule->count; j++)
+        {
+            uint16_t mask = schedule->steps[j].setMask;
+            schedule->steps[j].setMask = schedule->steps[j].clearMask;
+            schedule->steps[j].clearMask = mask;
+        }
+    }
+}
+
+static void pwm_update()
+{
+    if (!pwmInfo.running)
+        return;
+
+    /* Once pending flag is cleared, handler does not touch shadow schedule */
+    pwmInfo._pending = false;
+
+    PWMSchedule *schedule = &pwmInfo._schedules[pwmInfo._active ^ 1];
+    pwm_build_schedule(schedule);
+
+    taskENTER_CRITICAL();
+    pwmInfo._pending = true;
+    if (!pwmInfo._timerRunning)
+    {
+        /* Output is constant, start new period right away */
+        pwmInfo._step = 0;
+        if (schedule->count > 1)
+        {
+            timer_set_reload(FRC1, false);
+            timer_set_interrupts(FRC1, true);
+            timer_set_run(FRC1, true);
+            pwmInfo._timerRunning = true;
+        }
+        frc1_interrupt_handler(NULL);
+    }
+    taskEXIT_CRITICAL();
 }
 
 void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse)
@@ -85,9 +216,11 @@ void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse)
 
     /* Initialize */
     pwmInfo._maxLoad = 0;
-    pwmInfo._onLoad = 0;
-    pwmInfo._offLoad = 0;
-    pwmInfo._step = PERIOD_ON;
+    pwmInfo._pinMask = 0;
+    pwmInfo._active = 0;
+    pwmInfo._pending = false;
+    pwmInfo._timerRunning = false;
+    pwmInfo._step = 0;
     pwmInfo.reverse = reverse;
 
     /* Save pins information */
@@ -97,6 +230,8 @@ void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse)
     for (; i < npins; ++i)
     {
         pwmInfo.pins[i].pin = pins[i];
+        pwmInfo.pins[i].duty = 0;
+        pwmInfo._pinMask |= BIT(pins[i]);
 
         /* configure GPIOs */
         gpio_enable(pins[i], GPIO_OUTPUT);
@@ -138,13 +273,22 @@ void pwm_set_freq(uint16_t freq)
 
 void pwm_set_duty(uint16_t duty)
 {
-    pwmInfo.dutyCycle = duty;
-    if (duty == 0 || duty == UINT16_MAX)
+    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
     {
-        pwmInfo.output = (duty == UINT16_MAX);
+        pwmInfo.pins[i].duty = duty;
     }
-    debug("Duty set at %u",pwmInfo.dutyCycle);
-    pwm_restart();
+    debug("Duty set at %u",duty);
+    pwm_update();
+}
+
+void pwm_set_channel_duty(uint8_t channel, uint16_t duty)
+{
+    if (channel >= pwmInfo.usedPins)
+        return;
+
+    pwmInfo.pins[channel].duty = duty;
+    debug("Channel %u duty set at %u",channel,duty);
+    pwm_update();
 }
 
 void pwm_restart()
@@ -158,49 +302,24 @@ void pwm_restart()
 
 void pwm_start()
 {
-    pwmInfo._onLoad = pwmInfo.dutyCycle * pwmInfo._maxLoad / UINT16_MAX;
-    pwmInfo._offLoad = pwmInfo._maxLoad - pwmInfo._onLoad;
-    pwmInfo._step = PERIOD_ON;
-
-    if(!pwmInfo._onLoad)
-    {
-        debug("Can't set timer with low duty and frequency settings, put duty at 0");
-        pwmInfo.dutyCycle = 0;
-    }
-
-    // 0% and 100% duty cycle are special cases: constant output.
-    if (pwmInfo.dutyCycle > 0 && pwmInfo.dutyCycle < UINT16_MAX)
-    {
-        // Trigger ON
-        uint8_t i = 0;
-        for (; i < pwmInfo.usedPins; ++i)
-        {
-            gpio_write(pwmInfo.pins[i].pin, pwmInfo.reverse ? false : true);
-        }
-        timer_set_load(FRC1, pwmInfo._onLoad);
-        timer_set_reload(FRC1, false);
-        timer_set_interrupts(FRC1, true);
-        timer_set_run(FRC1, true);
-    }
-    else
-    {
-        for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
-        {
-            gpio_write(pwmInfo.pins[i].pin, pwmInfo.reverse ? !pwmInfo.output : pwmInfo.output );
-        }       
-    }
-    debug("PWM started");
     pwmInfo.running = 1;
+    pwm_update();
+    debug("PWM started");
 }
 
 void pwm_stop()
 {
     timer_set_interrupts(FRC1, false);
     timer_set_run(FRC1, false);
-    for (uint8_t i = 0; i < pwmInfo.usedPins; ++i)
-    {
-        gpio_write(pwmInfo.pins[i].pin, pwmInfo.reverse ? true : false);
-    }       
+    pwmInfo._timerRunning = false;
+    pwmInfo._pending = false;
+    pwmInfo._step = 0;
+
+    if (pwmInfo.reverse)
+        GPIO.OUT_SET = pwmInfo._pinMask;
+    else
+        GPIO.OUT_CLEAR = pwmInfo._pinMask;
+
     debug("PWM stopped");
     pwmInfo.running = 0;
 }
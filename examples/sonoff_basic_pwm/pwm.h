@@ -21,7 +21,7 @@ extern "C" {
 /**
  * Initialize pwm
  * @param npins Number of pwm pin used
- * @param pins Array pointer to the pins
+ * @param pins Array pointer to the pins (GPIO0-GPIO15)
  * @param reverse If true, the pwm work in reverse mode
  */    
 void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse);
@@ -33,11 +33,19 @@ void pwm_init(uint8_t npins, const uint8_t* pins, uint8_t reverse);
 void pwm_set_freq(uint16_t freq);
 
 /**
- * Set Duty between 0 and UINT16_MAX
+ * Set Duty between 0 and UINT16_MAX on all channels
  * @param duty Duty value
  */  
 void pwm_set_duty(uint16_t duty);
 
+/**
+ * Set Duty between 0 and UINT16_MAX on a single channel.
+ * New duty takes effect at the start of next period, without restarting pwm.
+ * @param channel Index of the pin in pins array passed to pwm_init
+ * @param duty Duty value
+ */
+void pwm_set_channel_duty(uint8_t channel, uint16_t duty);
+
 /**
  * Restart the pwm signal
  */  
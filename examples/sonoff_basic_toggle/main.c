@@ -40,7 +40,7 @@
 #include <homekit/characteristics.h>
 #include <wifi_config.h>
 
-#include "button.h"
+#include <gpio_button.h>
 
 // The GPIO pin that is connected to the relay on the Sonoff Basic.
 const int relay_gpio = 12;
@@ -51,7 +51,7 @@ const int button_gpio = 0;
 
 
 // NEW
-#include "toggle.h"
+#include <gpio_toggle.h>
 // The GPIO pin that is connected to the header on the Sonoff Basic (external switch).
 const int toggle_gpio = 14;
 void toggle_callback(uint8_t gpio);
@@ -59,7 +59,7 @@ void toggle_callback(uint8_t gpio);
 
 
 void switch_on_callback(homekit_characteristic_t *_ch, homekit_value_t on, void *context);
-void button_callback(uint8_t gpio, button_event_t event);
+void button_callback(uint8_t gpio, gpio_button_event_t event);
 
 void relay_write(bool on) {
     gpio_write(relay_gpio, on ? 1 : 0);
@@ -111,15 +111,15 @@ void switch_on_callback(homekit_characteristic_t *_ch, homekit_value_t on, void
     relay_write(switch_on.value.bool_value);
 }
 
-void button_callback(uint8_t gpio, button_event_t event) {
+void button_callback(uint8_t gpio, gpio_button_event_t event) {
     switch (event) {
-        case button_event_single_press:
+        case gpio_button_event_single_press:
             printf("Toggling relay due to button at GPIO %2d\n", gpio);
             switch_on.value.bool_value = !switch_on.value.bool_value;
             relay_write(switch_on.value.bool_value);
             homekit_characteristic_notify(&switch_on, switch_on.value);
             break;
-        case button_event_long_press:
+        case gpio_button_event_long_press:
             reset_configuration();
             break;
         default:
@@ -211,11 +211,11 @@ void user_init(void) {
     wifi_config_init("Sonoff Basic", NULL, on_wifi_ready);
     gpio_init();
 
-    if (button_create(button_gpio, 0, 4000, button_callback)) {
+    if (gpio_button_create(button_gpio, 0, 4000, button_callback)) {
         printf("Failed to initialize button\n");
     }
     
-    if (toggle_create(toggle_gpio, toggle_callback)) {
+    if (gpio_toggle_create(toggle_gpio, toggle_callback)) {
         printf("Failed to initialize toggle\n");
     }
     
@@ -16,21 +16,24 @@
 #include <homekit/characteristics.h>
 #include <wifi_config.h>
 
-#include "button.h"
+#include <gpio_button.h>
+#include <cover.h>
+#include <actuator.h>
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
 #define POSITION_OPEN 100
 #define POSITION_CLOSED 0
-#define POSITION_STATE_CLOSING 0
-#define POSITION_STATE_OPENING 1
-#define POSITION_STATE_STOPPED 2
 
 // number of seconds the blinds take to move from fully open to fully closed position
 #define SECONDS_FROM_CLOSED_TO_OPEN 15
+// Motor run time past the end position, resets position estimate, in milliseconds
+#define END_STOP_TIME 1000
+// Pause between motor directions, in milliseconds
+#define REVERSE_DEAD_TIME 500
 
-TaskHandle_t updateStateTask;
+cover_t blinds;
 homekit_characteristic_t current_position;
 homekit_characteristic_t target_position;
 homekit_characteristic_t position_state;
@@ -55,31 +58,20 @@ const int button_down = 0;
 const int relay_up = 12;
 const int relay_down = 5;
 
-void target_position_changed();
+// Relays share exclusion group, so motor is never driven both ways
+int relay_up_channel = -1;
+int relay_down_channel = -1;
 
 
-void relay_write(int relay, bool on) {
-    gpio_write(relay, on ? 1 : 0);
-}
-
 void led_write(bool on) {
     gpio_write(led_gpio, on ? 0 : 1);
 }
 
-void relays_write(int state) {
-    switch (state){
-	case POSITION_STATE_CLOSING:
-	    gpio_write(relay_up, 0);
-	    gpio_write(relay_down, 1);
-	    break;
-	case POSITION_STATE_OPENING:
-	    gpio_write(relay_down, 0);
-	    gpio_write(relay_up, 1);
-	    break;
-	default:
-	    gpio_write(relay_down, 0);
-	    gpio_write(relay_up, 0);
-    }
+void relays_write(cover_t *cover, cover_state_t state) {
+    actuator_begin();
+    actuator_set(relay_up_channel, state == cover_state_opening);
+    actuator_set(relay_down_channel, state == cover_state_closing);
+    actuator_commit();
 }
 
 void reset_configuration_task() {
@@ -122,24 +114,36 @@ void gpio_init() {
     gpio_enable(button_up, GPIO_INPUT);
     gpio_enable(button_down, GPIO_INPUT);
 
-    gpio_enable(relay0_gpio, GPIO_OUTPUT);
-    gpio_enable(relay1_gpio, GPIO_OUTPUT);
-    relay_write(relay0_gpio, false);
-    relay_write(relay1_gpio, false);
+    actuator_config_t relay_config = {
+        .group = 1,
+        .dead_time = REVERSE_DEAD_TIME,
+    };
+
+    relay_config.name = "Up";
+    relay_config.gpio = relay_up;
+    relay_up_channel = actuator_add(&relay_config);
+
+    relay_config.name = "Down";
+    relay_config.gpio = relay_down;
+    relay_down_channel = actuator_add(&relay_config);
+
+    if (relay_up_channel < 0 || relay_down_channel < 0) {
+        printf("Failed to initialize relays\n");
+    }
 }
 
-void button_up_callback(uint8_t gpio_num, button_event_t event) {
+void button_up_callback(uint8_t gpio_num, gpio_button_event_t event) {
     // up button pressed
-    if (position_state.value.int_value != POSITION_STATE_STOPPED){ // if moving, stop
-	target_position.value.int_value = current_position.value.int_value;
-	target_position_changed();
+    if (cover_get_state(&blinds) != cover_state_stopped){ // if moving, stop
+	cover_stop(&blinds);
     }else{
         switch (event) {
-            case button_event_single_press:
+            case gpio_button_event_single_press:
 	        target_position.value.int_value = POSITION_OPEN;
-                target_position_changed();
+                homekit_characteristic_notify(&target_position, target_position.value);
+                cover_set_target(&blinds, target_position.value.int_value);
                 break;
-            case button_event_long_press:
+            case gpio_button_event_long_press:
                 //reset_configuration();
                 break;
             default:
@@ -148,18 +152,18 @@ void button_up_callback(uint8_t gpio_num, button_event_t event) {
     }
 }
 
-void button_down_callback(uint8_t gpio_num, button_event_t event) {
+void button_down_callback(uint8_t gpio_num, gpio_button_event_t event) {
     // down button pressed
-    if (position_state.value.int_value != POSITION_STATE_STOPPED){ // if moving, stop
-	target_position.value.int_value = current_position.value.int_value;
-	target_position_changed();
+    if (cover_get_state(&blinds) != cover_state_stopped){ // if moving, stop
+	cover_stop(&blinds);
     }else{
         switch (event) {
-            case button_event_single_press:
+            case gpio_button_event_single_press:
 	        target_position.value.int_value = POSITION_CLOSED;
-                target_position_changed();
+                homekit_characteristic_notify(&target_position, target_position.value);
+                cover_set_target(&blinds, target_position.value.int_value);
                 break;
-            case button_event_long_press:
+            case gpio_button_event_long_press:
                 //reset_configuration();
                 break;
             default:
@@ -168,34 +172,38 @@ void button_down_callback(uint8_t gpio_num, button_event_t event) {
     }
 }
 
-void update_state() {
-    while (true) {
-printf("update_state\n");
-	relays_write(position_state.value.int_value);
-        uint8_t position = current_position.value.int_value;
-        int8_t direction = position_state.value.int_value == POSITION_STATE_OPENING ? 1 : -1;
-        int16_t newPosition = position + direction;
-
-        printf("position %u, target %u\n", newPosition, target_position.value.int_value);
-
-        current_position.value.int_value = newPosition;
-        homekit_characteristic_notify(&current_position, current_position.value);
-
-        if (newPosition == target_position.value.int_value) {
-            printf("reached destination %u\n", newPosition);
-            position_state.value.int_value = POSITION_STATE_STOPPED;
-	    relays_write(position_state.value.int_value);
-            homekit_characteristic_notify(&position_state, position_state.value);
-            vTaskSuspend(updateStateTask);
-        }
+void blinds_changed(cover_t *cover) {
+    printf("position %u, target %u\n", cover_get_position(cover), cover_get_target(cover));
 
-        vTaskDelay(pdMS_TO_TICKS(SECONDS_FROM_CLOSED_TO_OPEN * 10));
+    current_position.value.int_value = cover_get_position(cover);
+    homekit_characteristic_notify(&current_position, current_position.value);
+
+    if (position_state.value.int_value != cover_get_state(cover)) {
+        position_state.value.int_value = cover_get_state(cover);
+        homekit_characteristic_notify(&position_state, position_state.value);
+    }
+
+    if (cover_get_state(cover) == cover_state_stopped &&
+            target_position.value.int_value != current_position.value.int_value) {
+        // Stopped by a button before reaching target
+        target_position.value.int_value = current_position.value.int_value;
+        homekit_characteristic_notify(&target_position, target_position.value);
     }
 }
 
-void update_state_init() {
-    xTaskCreate(update_state, "UpdateState", 256, NULL, tskIDLE_PRIORITY, &updateStateTask);
-    vTaskSuspend(updateStateTask);
+void blinds_init() {
+    cover_config_t cover_config = {
+        .open_time = SECONDS_FROM_CLOSED_TO_OPEN * 1000,
+        .close_time = SECONDS_FROM_CLOSED_TO_OPEN * 1000,
+        .end_stop_time = END_STOP_TIME,
+        // actuator keeps both relays off for the dead time on reversal
+        .reverse_delay = REVERSE_DEAD_TIME,
+        .motor = relays_write,
+        .on_change = blinds_changed,
+    };
+    if (cover_add(&blinds, &cover_config, current_position.value.int_value)) {
+        printf("Failed to initialize blinds\n");
+    }
 }
 
 void window_covering_identify(homekit_value_t _value) {
@@ -213,7 +221,7 @@ homekit_characteristic_t target_position = {
 };
 
 homekit_characteristic_t position_state = {
-    HOMEKIT_DECLARE_CHARACTERISTIC_POSITION_STATE(POSITION_STATE_STOPPED)
+    HOMEKIT_DECLARE_CHARACTERISTIC_POSITION_STATE(cover_state_stopped)
 };
 
 homekit_accessory_t *accessories[] = {
@@ -240,26 +248,9 @@ homekit_accessory_t *accessories[] = {
 };
 
 void on_update_target_position(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
-    target_position_changed();
-}
-
-void target_position_changed(){
     printf("Update target position to: %u\n", target_position.value.int_value);
 
-    if (target_position.value.int_value == current_position.value.int_value) {
-        printf("Current position equal to target. Stopping.\n");
-        position_state.value.int_value = POSITION_STATE_STOPPED;
-	relays_write(position_state.value.int_value);
-        homekit_characteristic_notify(&position_state, position_state.value);
-        vTaskSuspend(updateStateTask);
-    } else {
-        position_state.value.int_value = target_position.value.int_value > current_position.value.int_value
-            ? POSITION_STATE_OPENING
-            : POSITION_STATE_CLOSING;
-
-        homekit_characteristic_notify(&position_state, position_state.value);
-        vTaskResume(updateStateTask);
-    }
+    cover_set_target(&blinds, target_position.value.int_value);
 }
 
 homekit_server_config_t config = {
@@ -277,12 +268,12 @@ void user_init(void) {
     gpio_init();
 
     wifi_config_init("blinds", NULL, on_wifi_ready);
-    update_state_init();
+    blinds_init();
 
-    if (button_create(button_up, 0, 1000, button_up_callback)) {
+    if (gpio_button_create(button_up, 0, 1000, button_up_callback)) {
         printf("Failed to initialize button up\n");
     }
-    if (button_create(button_down, 0, 1000, button_down_callback)) {
+    if (gpio_button_create(button_down, 0, 1000, button_down_callback)) {
         printf("Failed to initialize button down\n");
     }
 }
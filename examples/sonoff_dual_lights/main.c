@@ -30,7 +30,7 @@
 #include <homekit/characteristics.h>
 // #include <wifi_config.h>
 
-#include "toggle.h"
+#include <gpio_toggle.h>
 #include "wifi.h"
 
 
@@ -253,7 +253,7 @@ void user_init(void) {
     wifi_init();
     on_wifi_ready();
 
-    if (toggle_create(button_gpio, toggle_callback)) {
+    if (gpio_toggle_create(button_gpio, toggle_callback)) {
         printf("Failed to initialize button\n");
     }
 }
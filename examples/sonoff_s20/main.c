@@ -33,7 +33,7 @@
 #include <homekit/characteristics.h>
 #include <wifi_config.h>
 
-#include "button.h"
+#include <gpio_button.h>
 
 // The GPIO pin that is connected to the relay on the Sonoff Basic.
 const int relay_gpio = 12;
@@ -43,7 +43,7 @@ const int led_gpio = 13;
 const int button_gpio = 0;
 
 void switch_on_callback(homekit_characteristic_t *_ch, homekit_value_t on, void *context);
-void button_callback(uint8_t gpio, button_event_t event);
+void button_callback(uint8_t gpio, gpio_button_event_t event);
 
 void relay_write(bool on) {
     gpio_write(relay_gpio, on ? 1 : 0);
@@ -101,15 +101,15 @@ void switch_on_callback(homekit_characteristic_t *_ch, homekit_value_t on, void
     relay_write(switch_on.value.bool_value);
 }
 
-void button_callback(uint8_t gpio, button_event_t event) {
+void button_callback(uint8_t gpio, gpio_button_event_t event) {
     switch (event) {
-        case button_event_single_press:
+        case gpio_button_event_single_press:
             printf("Toggling relay\n");
             switch_on.value.bool_value = !switch_on.value.bool_value;
             relay_write(switch_on.value.bool_value);
             homekit_characteristic_notify(&switch_on, switch_on.value);
             break;
-        case button_event_long_press:
+        case gpio_button_event_long_press:
             reset_configuration();
             break;
         default:
@@ -194,7 +194,7 @@ void user_init(void) {
     wifi_config_init("sonoff-outlet", NULL, on_wifi_ready);
     gpio_init();
 
-    if (button_create(button_gpio, 0, 10000, button_callback)) {
+    if (gpio_button_create(button_gpio, 0, 10000, button_callback)) {
         printf("Failed to initialize button\n");
     }
 }
@@ -8,6 +8,8 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <characteristic_notify.h>
+#include <sensor_pipeline.h>
 #include "wifi.h"
 
 #include <dht/dht.h>
@@ -37,32 +39,65 @@ void temperature_sensor_identify(homekit_value_t _value) {
 homekit_characteristic_t temperature = HOMEKIT_CHARACTERISTIC_(CURRENT_TEMPERATURE, 0);
 homekit_characteristic_t humidity    = HOMEKIT_CHARACTERISTIC_(CURRENT_RELATIVE_HUMIDITY, 0);
 
+// Readings are only pushed to controllers when they change by at least this much
+#define TEMPERATURE_NOTIFY_DEAD_BAND 0.1
+#define HUMIDITY_NOTIFY_DEAD_BAND 1
+// Minimum time between two notifications, in milliseconds
+#define SENSOR_NOTIFY_INTERVAL 10000
 
-void temperature_sensor_task(void *_args) {
-    gpio_set_pullup(SENSOR_PIN, false, false);
+// Sensor is read every SENSOR_FAST_INTERVAL while readings change, and
+// up to SENSOR_SLOW_INTERVAL apart while they are stable, in milliseconds
+#define SENSOR_FAST_INTERVAL 3000
+#define SENSOR_SLOW_INTERVAL 30000
+#define SENSOR_RETRY_INTERVAL 2000
 
-    float humidity_value, temperature_value;
-    while (1) {
-        bool success = dht_read_float_data(
-            DHT_TYPE_DHT11, SENSOR_PIN,
-            &humidity_value, &temperature_value
-        );
-        if (success) {
-            temperature.value.float_value = temperature_value;
-            humidity.value.float_value = humidity_value;
-
-            homekit_characteristic_notify(&temperature, HOMEKIT_FLOAT(temperature_value));
-            homekit_characteristic_notify(&humidity, HOMEKIT_FLOAT(humidity_value));
-        } else {
-            printf("Couldnt read data from sensor\n");
-        }
-
-        vTaskDelay(3000 / portTICK_PERIOD_MS);
-    }
+characteristic_notify_t temperature_notify;
+characteristic_notify_t humidity_notify;
+sensor_pipeline_t sensor;
+
+
+bool dht_read(float *values, void *context) {
+    return dht_read_float_data(DHT_TYPE_DHT11, SENSOR_PIN, &values[1], &values[0]);
 }
 
+
+void on_sensor_value(const float *values, void *context) {
+    temperature.value.float_value = values[0];
+    humidity.value.float_value = values[1];
+
+    characteristic_notify(&temperature_notify, HOMEKIT_FLOAT(values[0]));
+    characteristic_notify(&humidity_notify, HOMEKIT_FLOAT(values[1]));
+}
+
+
 void temperature_sensor_init() {
-    xTaskCreate(temperature_sensor_task, "Temperatore Sensor", 256, NULL, 2, NULL);
+    gpio_set_pullup(SENSOR_PIN, false, false);
+
+    characteristic_notify_init(&temperature_notify, &temperature, &(characteristic_notify_config_t) {
+        .min_interval = SENSOR_NOTIFY_INTERVAL,
+        .dead_band = TEMPERATURE_NOTIFY_DEAD_BAND,
+    });
+    characteristic_notify_init(&humidity_notify, &humidity, &(characteristic_notify_config_t) {
+        .min_interval = SENSOR_NOTIFY_INTERVAL,
+        .dead_band = HUMIDITY_NOTIFY_DEAD_BAND,
+    });
+
+    sensor_pipeline_config_t sensor_config = {
+        .read = dht_read,
+        // temperature, humidity
+        .channels = 2,
+        .median_size = 3,
+        .ema_alpha = 0.5,
+        .stable_delta = { TEMPERATURE_NOTIFY_DEAD_BAND, HUMIDITY_NOTIFY_DEAD_BAND },
+        .fast_interval = SENSOR_FAST_INTERVAL,
+        .slow_interval = SENSOR_SLOW_INTERVAL,
+        .retry_interval = SENSOR_RETRY_INTERVAL,
+        .on_value = on_sensor_value,
+    };
+    if (sensor_pipeline_init(&sensor, &sensor_config) ||
+            sensor_pipeline_start(&sensor, "Temperatore Sensor")) {
+        printf("Failed to start temperature sensor\n");
+    }
 }
 
 
@@ -36,6 +36,11 @@
 #include "wifi.h"
 
 #include <dht/dht.h>
+#include <actuator.h>
+
+#include <sensor_pipeline.h>
+
+#include "thermostat_control.h"
 
 
 #define LED_PIN 2
@@ -43,9 +48,23 @@
 #define FAN_PIN 14
 #define COOLER_PIN 12
 #define HEATER_PIN 13
+// Sensor is polled every TEMPERATURE_POLL_PERIOD while temperature changes
+// and up to TEMPERATURE_SLOW_POLL_PERIOD apart while it is stable
 #define TEMPERATURE_POLL_PERIOD 10000
+#define TEMPERATURE_SLOW_POLL_PERIOD 60000
+#define TEMPERATURE_RETRY_PERIOD 2000
 #define HEATER_FAN_DELAY 30000
 #define COOLER_FAN_DELAY 0
+// Heater and cooler switching limits, in milliseconds
+#define MIN_ON_TIME 60000
+#define MIN_OFF_TIME 180000
+#define HEAT_COOL_DEAD_TIME 60000
+// DHT11 reports whole degrees, so switch one reading away from setpoint
+#define DEAD_BAND 1.0
+// PI gains and time proportioning period, zero PI_KP uses on/off control
+#define PI_KP 0.0
+#define PI_KI 0.0
+#define PI_CYCLE_TIME 600000
 
 
 static void wifi_init() {
@@ -68,44 +87,78 @@ void thermostat_identify(homekit_value_t _value) {
 
 
 ETSTimer fan_timer;
+thermostat_control_t control;
+sensor_pipeline_t sensor;
+int heater_channel = -1;
+int cooler_channel = -1;
+int fan_channel = -1;
 
 
 void heaterOn() {
-    gpio_write(HEATER_PIN, false);
+    actuator_set(heater_channel, true);
 }
 
 
 void heaterOff() {
-    gpio_write(HEATER_PIN, true);
+    actuator_set(heater_channel, false);
 }
 
 
 void coolerOn() {
-    gpio_write(COOLER_PIN, false);
+    actuator_set(cooler_channel, true);
 }
 
 
 void coolerOff() {
-    gpio_write(COOLER_PIN, true);
+    actuator_set(cooler_channel, false);
 }
 
 
 void fan_alarm(void *arg) {
-    gpio_write(FAN_PIN, false);
+    actuator_set(fan_channel, true);
 }
 
 void fanOn(uint16_t delay) {
     if (delay > 0) {
         sdk_os_timer_arm(&fan_timer, delay, false);
     } else {
-        gpio_write(FAN_PIN, false);
+        actuator_set(fan_channel, true);
     }
 }
 
 
 void fanOff() {
     sdk_os_timer_disarm(&fan_timer);
-    gpio_write(FAN_PIN, true);
+    actuator_set(fan_channel, false);
+}
+
+
+void actuators_init() {
+    // Heater and cooler are never on together
+    actuator_config_t config = {
+        .active_low = true,
+        .group = 1,
+        .dead_time = HEAT_COOL_DEAD_TIME,
+    };
+
+    config.name = "Heater";
+    config.gpio = HEATER_PIN;
+    heater_channel = actuator_add(&config);
+
+    config.name = "Cooler";
+    config.gpio = COOLER_PIN;
+    cooler_channel = actuator_add(&config);
+
+    actuator_config_t fan_config = {
+        .name = "Fan",
+        .gpio = FAN_PIN,
+        .active_low = true,
+    };
+    fan_channel = actuator_add(&fan_config);
+
+    if (heater_channel < 0 || cooler_channel < 0 || fan_channel < 0) {
+        printf("Failed to initialize relays\n");
+    }
 }
 
 
@@ -138,80 +191,92 @@ homekit_characteristic_t current_humidity = HOMEKIT_CHARACTERISTIC_(CURRENT_RELA
 
 
 void update_state() {
-    uint8_t state = target_state.value.int_value;
-    if ((state == 1 && current_temperature.value.float_value < target_temperature.value.float_value) ||
-            (state == 3 && current_temperature.value.float_value < heating_threshold.value.float_value)) {
-        if (current_state.value.int_value != 1) {
-            current_state.value = HOMEKIT_UINT8(1);
-            homekit_characteristic_notify(&current_state, current_state.value);
-
+    thermostat_output_t output = thermostat_control_update(
+        &control,
+        target_state.value.int_value,
+        current_temperature.value.float_value,
+        target_temperature.value.float_value,
+        heating_threshold.value.float_value,
+        cooling_threshold.value.float_value,
+        xTaskGetTickCount() * portTICK_PERIOD_MS
+    );
+    if (current_state.value.int_value == output)
+        return;
+
+    current_state.value = HOMEKIT_UINT8(output);
+    homekit_characteristic_notify(&current_state, current_state.value);
+
+    actuator_begin();
+    switch (output) {
+        case thermostat_output_heat:
             heaterOn();
             coolerOff();
             fanOff();
             fanOn(HEATER_FAN_DELAY);
-        }
-    } else if ((state == 2 && current_temperature.value.float_value > target_temperature.value.float_value) ||
-            (state == 3 && current_temperature.value.float_value > cooling_threshold.value.float_value)) {
-        if (current_state.value.int_value != 2) {
-            current_state.value = HOMEKIT_UINT8(2);
-            homekit_characteristic_notify(&current_state, current_state.value);
-
+            break;
+        case thermostat_output_cool:
             coolerOn();
             heaterOff();
             fanOff();
             fanOn(COOLER_FAN_DELAY);
-        }
-    } else {
-        if (current_state.value.int_value != 0) {
-            current_state.value = HOMEKIT_UINT8(0);
-            homekit_characteristic_notify(&current_state, current_state.value);
-
+            break;
+        default:
             coolerOff();
             heaterOff();
             fanOff();
-        }
     }
+    actuator_commit();
 }
 
 
-void temperature_sensor_task(void *_args) {
-    sdk_os_timer_setfn(&fan_timer, fan_alarm, NULL);
+bool dht_read(float *values, void *context) {
+    return dht_read_float_data(DHT_TYPE_DHT11, TEMPERATURE_SENSOR_PIN, &values[1], &values[0]);
+}
 
-    gpio_set_pullup(TEMPERATURE_SENSOR_PIN, false, false);
 
-    gpio_enable(FAN_PIN, GPIO_OUTPUT);
-    gpio_enable(HEATER_PIN, GPIO_OUTPUT);
-    gpio_enable(COOLER_PIN, GPIO_OUTPUT);
-
-    fanOff();
-    heaterOff();
-    coolerOff();
-
-    float humidity_value, temperature_value;
-    while (1) {
-        bool success = dht_read_float_data(
-            DHT_TYPE_DHT11, TEMPERATURE_SENSOR_PIN,
-            &humidity_value, &temperature_value
-        );
-        if (success) {
-            printf("Got readings: temperature %g, humidity %g\n", temperature_value, humidity_value);
-            current_temperature.value = HOMEKIT_FLOAT(temperature_value);
-            current_humidity.value = HOMEKIT_FLOAT(humidity_value);
-
-            homekit_characteristic_notify(&current_temperature, current_temperature.value);
-            homekit_characteristic_notify(&current_humidity, current_humidity.value);
-
-            update_state();
-        } else {
-            printf("Couldnt read data from sensor\n");
-        }
-
-        vTaskDelay(TEMPERATURE_POLL_PERIOD / portTICK_PERIOD_MS);
-    }
+void on_sensor_value(const float *values, void *context) {
+    printf("Got readings: temperature %g, humidity %g\n", values[0], values[1]);
+    current_temperature.value = HOMEKIT_FLOAT(values[0]);
+    current_humidity.value = HOMEKIT_FLOAT(values[1]);
+
+    homekit_characteristic_notify(&current_temperature, current_temperature.value);
+    homekit_characteristic_notify(&current_humidity, current_humidity.value);
+
+    update_state();
 }
 
 void thermostat_init() {
-    xTaskCreate(temperature_sensor_task, "Thermostat", 256, NULL, 2, NULL);
+    thermostat_control_config_t control_config = {
+        .dead_band = DEAD_BAND,
+        .min_on_time = MIN_ON_TIME,
+        .min_off_time = MIN_OFF_TIME,
+        .kp = PI_KP,
+        .ki = PI_KI,
+        .cycle_time = PI_CYCLE_TIME,
+    };
+    thermostat_control_init(&control, &control_config, xTaskGetTickCount() * portTICK_PERIOD_MS);
+
+    sdk_os_timer_setfn(&fan_timer, fan_alarm, NULL);
+    actuators_init();
+
+    gpio_set_pullup(TEMPERATURE_SENSOR_PIN, false, false);
+
+    sensor_pipeline_config_t sensor_config = {
+        .read = dht_read,
+        // temperature, humidity
+        .channels = 2,
+        .median_size = 3,
+        .ema_alpha = 0.5,
+        .stable_delta = { 0.1, 1 },
+        .fast_interval = TEMPERATURE_POLL_PERIOD,
+        .slow_interval = TEMPERATURE_SLOW_POLL_PERIOD,
+        .retry_interval = TEMPERATURE_RETRY_PERIOD,
+        .on_value = on_sensor_value,
+    };
+    if (sensor_pipeline_init(&sensor, &sensor_config) ||
+            sensor_pipeline_start(&sensor, "Thermostat")) {
+        printf("Failed to start temperature sensor\n");
+    }
 }
 
 
@@ -0,0 +1,152 @@
+#include <string.h>
+
+#include "thermostat_control.h"
+
+
+static inline float clamp(float value, float min, float max) {
+    return value < min ? min : (value > max ? max : value);
+}
+
+
+// Picks loop that should be in control
+static thermostat_output_t thermostat_control_loop(thermostat_control_t *control,
+                                                   thermostat_mode_t mode,
+                                                   float temperature,
+                                                   float heating_threshold,
+                                                   float cooling_threshold) {
+    switch (mode) {
+        case thermostat_mode_heat:
+            return thermostat_output_heat;
+        case thermostat_mode_cool:
+            return thermostat_output_cool;
+        case thermostat_mode_auto:
+            break;
+        default:
+            return thermostat_output_off;
+    }
+
+    // Keep current loop until the other threshold is crossed, so auto mode
+    // does not flip between heating and cooling inside the comfort band
+    if (control->loop == thermostat_output_heat && temperature <= cooling_threshold)
+        return thermostat_output_heat;
+    if (control->loop == thermostat_output_cool && temperature >= heating_threshold)
+        return thermostat_output_cool;
+
+    float half_band = control->config.dead_band / 2;
+    if (temperature < heating_threshold - half_band)
+        return thermostat_output_heat;
+    if (temperature > cooling_threshold + half_band)
+        return thermostat_output_cool;
+
+    return thermostat_output_off;
+}
+
+
+// On/off control, error is positive when output is needed
+static bool thermostat_control_on_off(thermostat_control_t *control, float error) {
+    float half_band = control->config.dead_band / 2;
+    if (control->output == control->loop)
+        return error > -half_band;
+
+    return error > half_band;
+}
+
+
+// PI control with time proportioned output
+static bool thermostat_control_pi(thermostat_control_t *control, float error, uint32_t now) {
+    thermostat_control_config_t *config = &control->config;
+
+    float dt = (now - control->last_update) / 1000.0;
+    if (config->ki > 0) {
+        // Integral is limited to what can drive output fully (anti-windup)
+        control->integral = clamp(control->integral + error * dt, 0, 1 / config->ki);
+    }
+    control->duty = clamp(config->kp * error + config->ki * control->integral, 0, 1);
+
+    uint32_t position = now - control->cycle_start;
+    if (position >= config->cycle_time) {
+        control->cycle_start = now;
+        position = 0;
+    }
+
+    uint32_t on_time = control->duty * config->cycle_time;
+    if (on_time < config->min_on_time)
+        on_time = 0;
+    else if (config->cycle_time - on_time < config->min_off_time)
+        on_time = config->cycle_time;
+
+    return position < on_time;
+}
+
+
+void thermostat_control_init(thermostat_control_t *control,
+                             const thermostat_control_config_t *config,
+                             uint32_t now) {
+    memset(control, 0, sizeof(*control));
+    control->config = *config;
+    control->output = thermostat_output_off;
+    control->loop = thermostat_output_off;
+    control->changed = now - config->min_off_time;
+    control->cycle_start = now;
+    control->last_update = now;
+}
+
+
+thermostat_output_t thermostat_control_update(thermostat_control_t *control,
+                                              thermostat_mode_t mode,
+                                              float temperature,
+                                              float target,
+                                              float heating_threshold,
+                                              float cooling_threshold,
+                                              uint32_t now) {
+    thermostat_output_t loop = thermostat_control_loop(
+        control, mode, temperature, heating_threshold, cooling_threshold
+    );
+    if (loop != control->loop) {
+        control->loop = loop;
+        control->integral = 0;
+        control->cycle_start = now;
+    }
+
+    bool on = false;
+    if (loop != thermostat_output_off) {
+        float setpoint = target;
+        if (mode == thermostat_mode_auto)
+            setpoint = (loop == thermostat_output_heat) ? heating_threshold : cooling_threshold;
+
+        float error = (loop == thermostat_output_heat) ? setpoint - temperature : temperature - setpoint;
+
+        on = (control->config.kp > 0)
+            ? thermostat_control_pi(control, error, now)
+            : thermostat_control_on_off(control, error);
+    }
+    control->last_update = now;
+
+    thermostat_output_t output = on ? loop : thermostat_output_off;
+    if (output == control->output)
+        return control->output;
+
+    // Switching between heating and cooling goes through off
+    if (control->output != thermostat_output_off) {
+        if (now - control->changed < control->config.min_on_time) {
+            control->stats.held++;
+            return control->output;
+        }
+        output = thermostat_output_off;
+    } else if (now - control->changed < control->config.min_off_time) {
+        control->stats.held++;
+        return control->output;
+    }
+
+    control->output = output;
+    control->changed = now;
+    control->stats.transitions++;
+
+    return control->output;
+}
+
+
+void thermostat_control_get_stats(thermostat_control_t *control,
+                                  thermostat_control_stats_t *stats) {
+    *stats = control->stats;
+}
@@ -0,0 +1,114 @@
+/*
+ * Thermostat control core.
+ *
+ * Decides whether heater or cooler should run, given readings and
+ * setpoints. It does not talk to hardware or take time on its own, so
+ * the same code can be driven from a recorded temperature trace.
+ *
+ * Two control laws are available:
+ *  - on/off with a dead band: output goes on when temperature is more than
+ *    half of dead band on the wrong side of setpoint and off once it is
+ *    half of dead band past it;
+ *  - PI (when kp is not zero): duty cycle computed from error is applied
+ *    by keeping output on for that fraction of each cycle_time.
+ *
+ * Both are subject to minimum on and off times, so jittery readings or
+ * setpoint changes never short-cycle a compressor. Switching between
+ * heating and cooling always goes through off.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Values match HomeKit TARGET_HEATING_COOLING_STATE
+typedef enum {
+    thermostat_mode_off = 0,
+    thermostat_mode_heat = 1,
+    thermostat_mode_cool = 2,
+    thermostat_mode_auto = 3,
+} thermostat_mode_t;
+
+// Values match HomeKit CURRENT_HEATING_COOLING_STATE
+typedef enum {
+    thermostat_output_off = 0,
+    thermostat_output_heat = 1,
+    thermostat_output_cool = 2,
+} thermostat_output_t;
+
+typedef struct {
+    // Width of the band around setpoint with no switching, in degrees
+    float dead_band;
+
+    // times in milliseconds
+    uint32_t min_on_time;
+    uint32_t min_off_time;
+
+    // PI gains, duty per degree and per degree-second. Zero kp selects
+    // on/off control.
+    float kp;
+    float ki;
+    // Time proportioning period for PI output, in milliseconds
+    uint32_t cycle_time;
+} thermostat_control_config_t;
+
+typedef struct {
+    // Number of times output changed
+    uint32_t transitions;
+    // Number of updates when output change was held back by minimum on/off time
+    uint32_t held;
+} thermostat_control_stats_t;
+
+typedef struct {
+    thermostat_control_config_t config;
+
+    thermostat_output_t output;
+    // Loop currently in control, stays while output is off between cycles
+    thermostat_output_t loop;
+    // time of last output change
+    uint32_t changed;
+
+    // PI state
+    float integral;
+    float duty;
+    uint32_t cycle_start;
+    uint32_t last_update;
+
+    thermostat_control_stats_t stats;
+} thermostat_control_t;
+
+/**
+    Initializes control with output off. Minimum off time is considered
+    elapsed, so output can go on with the first update.
+
+    @param control Control state
+    @param config Control configuration
+    @param now Current time in milliseconds
+*/
+void thermostat_control_init(thermostat_control_t *control,
+                             const thermostat_control_config_t *config,
+                             uint32_t now);
+
+/**
+    Computes new output. Needs to be called on every reading, and
+    periodically (well below cycle_time) when PI control is used.
+
+    @param control Control state
+    @param mode Requested mode
+    @param temperature Current temperature
+    @param target Setpoint for heat and cool modes
+    @param heating_threshold Heating setpoint for auto mode
+    @param cooling_threshold Cooling setpoint for auto mode
+    @param now Current time in milliseconds
+    @return Output that should be active
+*/
+thermostat_output_t thermostat_control_update(thermostat_control_t *control,
+                                              thermostat_mode_t mode,
+                                              float temperature,
+                                              float target,
+                                              float heating_threshold,
+                                              float cooling_threshold,
+                                              uint32_t now);
+
+void thermostat_control_get_stats(thermostat_control_t *control,
+                                  thermostat_control_stats_t *stats);
@@ -11,6 +11,8 @@
 
 #include <homekit/homekit.h>
 #include <homekit/characteristics.h>
+#include <characteristic_notify.h>
+#include <cover.h>
 #include "wifi.h"
 
 #include <dht/dht.h>
@@ -20,16 +22,21 @@
 
 #define POSITION_OPEN 100
 #define POSITION_CLOSED 0
-#define POSITION_STATE_CLOSING 0
-#define POSITION_STATE_OPENING 1
-#define POSITION_STATE_STOPPED 2
 
-TaskHandle_t updateStateTask;
+// Position updates while moving are sent at most once per interval, final position is flushed
+#define POSITION_NOTIFY_INTERVAL 2000
+
+// Time to travel between fully closed and fully open positions, in milliseconds
+#define TRAVEL_TIME 50000
+
 homekit_characteristic_t current_position;
 homekit_characteristic_t target_position;
 homekit_characteristic_t position_state;
 homekit_accessory_t *accessories[];
 
+characteristic_notify_t current_position_notify;
+cover_t window_cover;
+
 static void wifi_init() {
     struct sdk_station_config wifi_config = {
         .ssid = WIFI_SSID,
@@ -41,31 +48,43 @@ static void wifi_init() {
     sdk_wifi_station_connect();
 }
 
-void update_state() {
-    while (true) {
-        uint8_t position = current_position.value.int_value;
-        int8_t direction = position_state.value.int_value == POSITION_STATE_OPENING ? 1 : -1;
-        int16_t newPosition = position + direction;
+void cover_motor(cover_t *cover, cover_state_t state) {
+    // No motor attached, position is only simulated
+    printf("motor %s\n", state == cover_state_opening ? "opening" : state == cover_state_closing ? "closing" : "stopped");
+}
 
-        printf("position %u, target %u\n", newPosition, target_position.value.int_value);
+void cover_changed(cover_t *cover) {
+    printf("position %u, target %u\n", cover_get_position(cover), target_position.value.int_value);
 
-        current_position.value.int_value = newPosition;
-        homekit_characteristic_notify(&current_position, current_position.value);
+    current_position.value.int_value = cover_get_position(cover);
+    characteristic_notify(&current_position_notify, current_position.value);
 
-        if (newPosition == target_position.value.int_value) {
-            printf("reached destination %u\n", newPosition);
-            position_state.value.int_value = POSITION_STATE_STOPPED;
-            homekit_characteristic_notify(&position_state, position_state.value);
-            vTaskSuspend(updateStateTask);
-        }
+    if (position_state.value.int_value != cover_get_state(cover)) {
+        position_state.value.int_value = cover_get_state(cover);
+        homekit_characteristic_notify(&position_state, position_state.value);
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(500));
+    if (cover_get_state(cover) == cover_state_stopped) {
+        printf("reached destination %u\n", current_position.value.int_value);
+        characteristic_notify_flush(&current_position_notify);
     }
 }
 
 void update_state_init() {
-    xTaskCreate(update_state, "UpdateState", 256, NULL, tskIDLE_PRIORITY, &updateStateTask);
-    vTaskSuspend(updateStateTask);
+    characteristic_notify_config_t position_notify_config = {
+        .min_interval = POSITION_NOTIFY_INTERVAL,
+    };
+    characteristic_notify_init(&current_position_notify, &current_position, &position_notify_config);
+
+    cover_config_t cover_config = {
+        .open_time = TRAVEL_TIME,
+        .close_time = TRAVEL_TIME,
+        .motor = cover_motor,
+        .on_change = cover_changed,
+    };
+    if (cover_add(&window_cover, &cover_config, current_position.value.int_value)) {
+        printf("Failed to initialize cover\n");
+    }
 }
 
 void window_covering_identify(homekit_value_t _value) {
@@ -83,7 +102,7 @@ homekit_characteristic_t target_position = {
 };
 
 homekit_characteristic_t position_state = {
-    HOMEKIT_DECLARE_CHARACTERISTIC_POSITION_STATE(POSITION_STATE_STOPPED)
+    HOMEKIT_DECLARE_CHARACTERISTIC_POSITION_STATE(cover_state_stopped)
 };
 
 homekit_accessory_t *accessories[] = {
@@ -112,19 +131,7 @@ homekit_accessory_t *accessories[] = {
 void on_update_target_position(homekit_characteristic_t *ch, homekit_value_t value, void *context) {
     printf("Update target position to: %u\n", target_position.value.int_value);
 
-    if (target_position.value.int_value == current_position.value.int_value) {
-        printf("Current position equal to target. Stopping.\n");
-        position_state.value.int_value = POSITION_STATE_STOPPED;
-        homekit_characteristic_notify(&position_state, position_state.value);
-        vTaskSuspend(updateStateTask);
-    } else {
-        position_state.value.int_value = target_position.value.int_value > current_position.value.int_value
-            ? POSITION_STATE_OPENING
-            : POSITION_STATE_CLOSING;
-
-        homekit_characteristic_notify(&position_state, position_state.value);
-        vTaskResume(updateStateTask);
-    }
+    cover_set_target(&window_cover, target_position.value.int_value);
 }
 
 homekit_server_config_t config = {